@@ -0,0 +1,220 @@
+#include "archive.h"
+#include "helpers.h"	// files_in_folder, path_exists
+#include "log.h"
+#include <opencv2/highgui/highgui.hpp>	// imread
+#include <boost/filesystem.hpp>
+#include <fstream>		// ifstream, ofstream
+#include <cstring>		// memcmp, memcpy
+#include <cstdint>		// uint32_t, uint64_t
+using namespace mmp;
+
+namespace
+{
+	const char magic[8] = { 'M', 'M', 'P', 'A', 'R', 'C', '0', '2' };
+
+	// pixels of every image start at a cache line
+	const std::uint64_t alignment = 64;
+
+	//
+	// file layout (native byte order):
+	// magic, image count, index entries (offset, file size, file time, rows, cols, type, name length,
+	// name), pixels
+	//
+	struct index_entry
+	{
+		std::uint64_t offset;
+		std::uint64_t file_size;
+		std::int64_t file_time;
+		std::int32_t rows;
+		std::int32_t cols;
+		std::int32_t type;
+		std::uint32_t name_length;
+	};
+
+	// size and modification time of a file, false if it can't be queried
+	bool stat(const std::string& filename, std::uint64_t& size, std::int64_t& time)
+	{
+		boost::system::error_code size_error, time_error;
+		size = boost::filesystem::file_size(filename, size_error);
+		time = boost::filesystem::last_write_time(filename, time_error);
+		return !size_error && !time_error;
+	}
+
+	template<class T>
+	bool read(const char *& pos, const char * end, T& value)
+	{
+		if (std::size_t(end - pos) < sizeof(T))
+			return false;
+
+		std::memcpy(&value, pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+}
+
+image_archive::image_archive()
+{
+
+}
+
+bool image_archive::open(const std::string& filename)
+{
+	using namespace boost::interprocess;
+
+	close();
+	try
+	{
+		file = file_mapping(filename.c_str(), read_only);
+		region = mapped_region(file, read_only);
+	}
+	catch (const interprocess_exception&)
+	{
+		region = mapped_region();
+		return false;
+	}
+
+	const char * begin = static_cast<const char *>(region.get_address());
+	const char * end = begin + region.get_size();
+	const char * pos = begin;
+
+	std::uint64_t count = 0;
+	bool valid = std::size_t(end - pos) >= sizeof(magic) && !std::memcmp(pos, magic, sizeof(magic));
+	pos += valid ? sizeof(magic) : 0;
+	valid = valid && read(pos, end, count);
+	for (std::uint64_t i = 0; valid && i < count; i++)
+	{
+		index_entry index;
+		valid = read(pos, end, index) && std::size_t(end - pos) >= index.name_length;
+		if (!valid)
+			break;
+
+		_names.emplace_back(pos, index.name_length);
+		pos += index.name_length;
+
+		const entry e = { std::size_t(index.offset), index.rows, index.cols, index.type, index.file_size, index.file_time };
+		const std::size_t bytes = std::size_t(e.rows) * e.cols * CV_ELEM_SIZE(e.type);
+		valid = e.rows >= 0 && e.cols >= 0 && e.offset <= region.get_size() && bytes <= region.get_size() - e.offset;
+		entries.push_back(e);
+	}
+
+	if (!valid)
+		close();
+
+	return valid;
+}
+
+void image_archive::close()
+{
+	_names.clear();
+	entries.clear();
+	region = boost::interprocess::mapped_region();
+	file = boost::interprocess::file_mapping();
+}
+
+cv::Mat image_archive::operator[](std::size_t i) const
+{
+	auto& e = entries[i];
+	char * pixels = static_cast<char *>(region.get_address()) + e.offset;
+	return cv::Mat(e.rows, e.cols, e.type, pixels);
+}
+
+bool image_archive::up_to_date(const std::string& folder) const
+{
+	if (files_in_folder(folder) != _names)
+		return false;
+
+	for (std::size_t i = 0; i < entries.size(); i++)
+	{
+		std::uint64_t size;
+		std::int64_t time;
+		if (!stat(_names[i], size, time) || size != entries[i].file_size || time != entries[i].file_time)
+			return false;
+	}
+
+	return true;
+}
+
+bool image_archive::pack(const std::string& folder, const std::string& filename)
+{
+	const auto files = files_in_folder(folder);
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	//
+	// the index has a fixed size, so the pixels are appended and the index is written last
+	//
+	std::uint64_t offset = sizeof(magic) + sizeof(std::uint64_t);
+	for (auto& name : files)
+		offset += sizeof(index_entry) + name.size();
+
+	std::vector<index_entry> index;
+	index.reserve(files.size());
+	const char padding[alignment] = {};
+	for (std::size_t i = 0; i < files.size(); i++)
+	{
+		// stat before decoding, a file changed in between makes the archive outdated rather than wrong
+		std::uint64_t size;
+		std::int64_t time;
+		if (!stat(files[i], size, time))
+			return false;
+
+		cv::Mat img = cv::imread(files[i]);
+		if (!img.isContinuous())
+			img = img.clone();
+
+		const std::uint64_t aligned = (offset + alignment - 1) / alignment * alignment;
+		const index_entry e = { aligned, size, time, img.rows, img.cols, img.type(), std::uint32_t(files[i].size()) };
+		index.push_back(e);
+
+		out.seekp(std::streamoff(offset));
+		out.write(padding, std::streamsize(aligned - offset));
+		out.write(reinterpret_cast<const char *>(img.data), std::streamsize(img.total() * img.elemSize()));
+		offset = aligned + img.total() * img.elemSize();
+
+		print_progress("images packed", (unsigned long)(i + 1), files.size(), files[i]);
+	}
+
+	const std::uint64_t count = files.size();
+	out.seekp(0);
+	out.write(magic, sizeof(magic));
+	out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+	for (std::size_t i = 0; i < files.size(); i++)
+	{
+		out.write(reinterpret_cast<const char *>(&index[i]), sizeof(index_entry));
+		out.write(files[i].data(), std::streamsize(files[i].size()));
+	}
+
+	return bool(out);
+}
+
+std::string image_archive::file_of(const std::string& folder)
+{
+	auto path = folder;
+	while (!path.empty() && (path.back() == '/' || path.back() == '\\'))
+		path.pop_back();
+
+	return path + ".mmpa";
+}
+
+std::vector<std::string> mmp::dataset_files(const std::string& folder, bool use_archive, image_archive& archive)
+{
+	if (!use_archive)
+		return files_in_folder(folder);
+
+	const auto filename = image_archive::file_of(folder);
+	if (!archive.open(filename))
+	{
+		log << to::both << "no archive [" << filename << "] (pack it with pack_archives), reading the folder instead" << std::endl;
+		return files_in_folder(folder);
+	}
+
+	if (!archive.up_to_date(folder))
+	{
+		archive.close();
+		log << to::both << "archive [" << filename << "] does not match [" << folder << "] (pack it again with pack_archives), reading the folder instead" << std::endl;
+		return files_in_folder(folder);
+	}
+
+	return archive.names();
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <opencv2/core/core.hpp>	// Mat
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>		// uint64_t, int64_t
+
+namespace mmp
+{
+	// the decoded images of a dataset folder in one file: an index (file name, file size and
+	// modification time, size and type of every image) followed by the raw pixels. the file is
+	// memory-mapped and the images are mats pointing into the mapping, so reading an image neither
+	// decodes nor copies it
+	class image_archive
+	{
+	private:
+		struct entry
+		{
+			std::size_t offset;
+			int rows;
+			int cols;
+			int type;
+			std::uint64_t file_size;
+			std::int64_t file_time;
+		};
+
+		boost::interprocess::file_mapping file;
+		boost::interprocess::mapped_region region;
+		std::vector<std::string> _names;
+		std::vector<entry> entries;
+
+	public:
+		image_archive();
+
+		// false if the file is no (valid) archive
+		bool open(const std::string& filename);
+		bool is_open() const { return region.get_address() != nullptr; }
+		void close();
+
+		// the files the archive was packed from, in the order of files_in_folder
+		const std::vector<std::string>& names() const { return _names; }
+		std::size_t size() const { return entries.size(); }
+
+		// true if the folder still holds exactly the files the archive was packed from, with the
+		// same sizes and modification times
+		bool up_to_date(const std::string& folder) const;
+
+		// the mapping is read-only, the pixels must not be written
+		cv::Mat operator[](std::size_t i) const;
+
+		// decodes all images of the folder into an archive
+		static bool pack(const std::string& folder, const std::string& filename);
+
+		// <folder>.mmpa
+		static std::string file_of(const std::string& folder);
+	};
+
+	// the images of a dataset folder, taken from its archive if use_archive is set. a missing or
+	// outdated archive is not used (the folder is read instead), archives are only written by pack
+	std::vector<std::string> dataset_files(const std::string& folder, bool use_archive, image_archive& archive);
+}
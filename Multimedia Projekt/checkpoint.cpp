@@ -0,0 +1,123 @@
+#include "checkpoint.h"
+#include <fstream>		// ifstream, ofstream
+#include <algorithm>	// find, equal, move
+#include <iterator>	// back_inserter
+#include <cstdio>		// rename
+#include <cstdint>		// uint64_t
+#include <sstream>		// stringstream
+#include <iomanip>		// hex, setw, setfill
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>	// MoveFileExA
+#endif
+using namespace mmp;
+
+namespace
+{
+	const char magic[8] = { 'M', 'M', 'P', 'F', 'E', 'A', 'T', '1' };
+
+	// the target is replaced atomically, so a crash at any point leaves either the previous or the new file
+	bool replace(const std::string& tmp, const std::string& filename)
+	{
+#ifdef _WIN32
+		// rename fails on windows if the target exists
+		return MoveFileExA(tmp.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		return !std::rename(tmp.c_str(), filename.c_str());
+#endif
+	}
+}
+
+checkpoint::checkpoint(const std::string& p, const std::string& k)
+	: prefix(p), key(k)
+{
+	std::ifstream in(prefix + ".manifest");
+	std::string line;
+	if (!std::getline(in, line) || line != key)
+		return;
+
+	while (std::getline(in, line))
+	{
+		if (!line.empty())
+			completed.push_back(line);
+	}
+}
+
+bool checkpoint::done(const std::string& stage) const
+{
+	return std::find(completed.begin(), completed.end(), stage) != completed.end();
+}
+
+void checkpoint::complete(const std::string& stage)
+{
+	if (!done(stage))
+		completed.push_back(stage);
+
+	write_manifest();
+}
+
+void checkpoint::write_manifest() const
+{
+	const auto filename = prefix + ".manifest";
+	{
+		std::ofstream out(filename + ".tmp", std::ios::trunc);
+		out << key << std::endl;
+		for (auto& stage : completed)
+			out << stage << std::endl;
+	}
+
+	replace(filename + ".tmp", filename);
+}
+
+std::string checkpoint::hash(const std::string& data)
+{
+	std::uint64_t h = 14695981039346656037ull;
+	for (unsigned char c : data)
+	{
+		h ^= c;
+		h *= 1099511628211ull;
+	}
+
+	std::stringstream str;
+	str << std::hex << std::setw(16) << std::setfill('0') << h;
+	return str.str();
+}
+
+bool checkpoint::save(const std::deque<svm::sparse_vector>& svecs, const std::string& filename)
+{
+	{
+		std::ofstream out(filename + ".tmp", std::ios::binary | std::ios::trunc);
+		const std::uint64_t count = svecs.size();
+		out.write(magic, sizeof(magic));
+		out.write((const char *)&count, sizeof(count));
+		for (auto& svec : svecs)
+			svec.write(out);
+
+		if (!out)
+			return false;
+	}
+
+	return replace(filename + ".tmp", filename);
+}
+
+bool checkpoint::load(const std::string& filename, std::deque<svm::sparse_vector>& svecs)
+{
+	std::ifstream in(filename, std::ios::binary);
+	char header[sizeof(magic)] = {};
+	std::uint64_t count = 0;
+	in.read(header, sizeof(header));
+	in.read((char *)&count, sizeof(count));
+	if (!in || !std::equal(header, header + sizeof(header), magic))
+		return false;
+
+	std::deque<svm::sparse_vector> loaded;
+	for (std::uint64_t i = 0; i < count && in; i++)
+		loaded.push_back(svm::sparse_vector::read(in));
+
+	if (!in)
+		return false;
+
+	std::move(loaded.begin(), loaded.end(), std::back_inserter(svecs));
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include <string>
+#include <svm_light/svm.h>	// sparse_vector
+
+namespace mmp
+{
+	// the completed stages of a training run, recorded in a manifest (<prefix>.manifest) together with the
+	// key of the run (a hash of the configuration and the input files). a manifest with a different key
+	// is discarded, so only a run with the same configuration and the same images is resumed
+	class checkpoint
+	{
+	private:
+		std::string prefix;
+		std::string key;
+		std::vector<std::string> completed;
+
+		void write_manifest() const;
+
+	public:
+		checkpoint(const std::string& prefix, const std::string& key);
+
+		bool done(const std::string& stage) const;
+		// records the stage, its output has to be written before
+		void complete(const std::string& stage);
+
+		// output file of a stage (<prefix>.<stage>)
+		std::string file(const std::string& stage) const { return prefix + "." + stage; }
+
+		// 64 bit FNV-1a (in hex), the same on every platform and run
+		static std::string hash(const std::string& data);
+
+		// feature sets of a stage, the files are replaced atomically
+		static bool save(const std::deque<svm::sparse_vector>& svecs, const std::string& filename);
+		static bool load(const std::string& filename, std::deque<svm::sparse_vector>& svecs);
+	};
+}
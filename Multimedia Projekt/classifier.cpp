@@ -4,46 +4,94 @@
 #include "helpers.h"
 #include "log.h"
 #include "inria.h"
-#include <opencv2/highgui/highgui.hpp>	// imread
+#include "kernels.h"
+#include "geometry.h"
+#include "prefetch.h"
+#include "feature_cache.h"
+#include "checkpoint.h"
+#include "evaulation.h"	// miss_rate
 #include <utility>		// pair, move
 #include <ctime>		// time
 #include <iterator>		// back_inserter, advance, make_move_iterator
 #include <set>
+#include <numeric>		// iota
+#include <algorithm>	// sort
+#include <limits>		// numeric_limits
+#include <fstream>		// ifstream, ofstream
+#include <cmath>		// fabs
+#include <memory>		// unique_ptr
+#include <sstream>		// stringstream
+#include <functional>	// reference_wrapper, cref
 using namespace mmp;
 
 namespace
 {
 	cv::RNG rng = std::time(nullptr);
 
+	// iterates the values of a (window) mat row by row
 	struct mat_iter
 	{
-		cv::MatConstIterator_<hog::vector_type> iter;
-		int c;
+		const cv::Mat * mat;
+		int y;
+		const float * value;
+		const float * row_end;
 
-		mat_iter(const cv::MatConstIterator_<hog::vector_type>& _iter) : iter(_iter), c(0) { }
-
-		float operator*() const { return (*iter)[c]; }
-		void operator++() 
+		mat_iter(const cv::Mat& m, int row) : mat(&m), y(row), value(nullptr), row_end(nullptr)
 		{
-			if (++c % hog::dimensions == 0) 
-			{ 
-				++iter; 
-				c = 0; 
+			if (y < mat->rows)
+			{
+				value = mat->ptr<float>(y);
+				row_end = value + mat->cols * mat->channels();
 			}
 		}
 
-		bool operator!=(const mat_iter& rhs) { return iter != rhs.iter; }
+		float operator*() const { return *value; }
+		void operator++()
+		{
+			if (++value == row_end)
+				*this = mat_iter(*mat, y + 1);
+		}
+
+		bool operator!=(const mat_iter& rhs) { return value != rhs.value; }
 	};
+
+	// everything the training output depends on: the configuration and the training images
+	std::string training_key(const inria_cfg& cfg, const std::vector<std::string>& positives, const std::vector<std::string>& negatives)
+	{
+		std::stringstream key;
+		key.precision(17);
+		key << geometry::active().to_string() << ' ' << cfg.svm_c() << ' ' << cfg.random_windows_per_negative_training_sample() << ' '
+			<< cfg.num_hard_false_positive_retrain() << ' ' << cfg.cell_subdivisions() << ' ' << cfg.compact_features() << ' '
+			<< cfg.mirror_positives() << ' ' << cfg.mirror_hard_negatives() << ' ' << cfg.use_pca() << ' ' << cfg.pca_dimensions() << ' '
+			<< cfg.use_cascade() << ' ' << cfg.coarse_stride() << ' ' << cfg.coarse_margin() << ' ' << cfg.low_rank() << ' '
+			<< cfg.use_fft() << ' ' << cfg.use_quantized() << ' ' << cfg.normalized_positive_training_x_offset() << ' '
+			<< cfg.normalized_positive_training_y_offset() << ' ' << cfg.cv_folds() << ' ' << cfg.cv_fppw() << std::endl;
+
+		for (auto c : cfg.svm_c_grid())
+			key << c << ' ';
+		key << std::endl;
+
+		for (auto& filename : positives)
+			key << filename << std::endl;
+		key << std::endl;
+		for (auto& filename : negatives)
+			key << filename << std::endl;
+
+		return checkpoint::hash(key.str());
+	}
 }
 
 classifier::classifier()
-	: model(nullptr)
+	: model(nullptr), cascade_enabled(false), pca_enabled(false), pca_max_error(0)
 {		
 
 }
 
 classifier::classifier(classifier&& rhs)
-	: model(rhs.model), positives(std::move(rhs.positives)), negatives(std::move(rhs.negatives))
+	: model(rhs.model), positives(std::move(rhs.positives)), negatives(std::move(rhs.negatives)),
+	cascade_enabled(rhs.cascade_enabled), cascade_order(std::move(rhs.cascade_order)), cascade(std::move(rhs.cascade)),
+	pca_enabled(rhs.pca_enabled), pca(std::move(rhs.pca)), pca_weights(std::move(rhs.pca_weights)), pca_max_error(rhs.pca_max_error),
+	low_rank(std::move(rhs.low_rank)), fft(std::move(rhs.fft)), quantized(std::move(rhs.quantized))
 {
 	rhs.model = nullptr;
 }
@@ -60,138 +108,292 @@ void classifier::train(const inria_cfg& cfg)
 	log << to::both << "starting training at: " << time_string() << std::endl;	
 	unsigned long processed = 0;
 
+	image_archive positive_archive, negative_archive;
+	const auto positive_filenames = dataset_files(cfg.normalized_positive_train_path(), cfg.use_archives(), positive_archive);
+	const auto negative_filenames = dataset_files(cfg.negative_train_path(), cfg.use_archives(), negative_archive);
+
+	// with resume_training the stages a previous run (with the same configuration and images) completed are skipped
+	checkpoint stages(cfg.svm_file(), training_key(cfg, positive_filenames, negative_filenames));
+	auto done = [&](const std::string& stage)
+	{
+		return cfg.resume_training() && stages.done(stage);
+	};
+	auto complete = [&](const std::string& stage, const std::deque<svm::sparse_vector> * svecs)
+	{
+		if (!cfg.resume_training())
+			return;
+
+		if (svecs && !checkpoint::save(*svecs, stages.file(stage)))
+		{
+			log << to::both << "could not save [" << stages.file(stage) << "], the stage will be repeated on resume" << std::endl;
+			return;
+		}
+
+		stages.complete(stage);
+	};
+	auto resume = [&](const std::string& stage, std::deque<svm::sparse_vector>& svecs)
+	{
+		if (!done(stage))
+			return false;
+
+		if (!checkpoint::load(stages.file(stage), svecs))
+		{
+			log << to::both << "invalid checkpoint [" << stages.file(stage) << "] ignored" << std::endl;
+			svecs.clear();
+			return false;
+		}
+
+		log << to::both << "resumed stage [" << stage << "] (" << svecs.size() << " windows)" << std::endl;
+		return true;
+	};
+
+	if (done("svm_hard"))
+	{
+		log << to::both << "training was completed by a previous run (" << cfg.svm_file_hard() << ")" << std::endl;
+		log << target;
+		return;
+	}
+
 	//
 	// positives
 	//
-	const auto positive_filenames = files_in_folder(cfg.normalized_positive_train_path());
 	const cv::Rect positive_roi(
 		cfg.normalized_positive_training_x_offset(), cfg.normalized_positive_training_y_offset(), // both should be 16
-		sliding_window::width, sliding_window::height
+		sliding_window::width(), sliding_window::height()
 	);
 
-#pragma omp parallel for schedule(static)
-	for (long i = 0; i < positive_filenames.size(); i++)
+	if (!resume("positives", positives))
 	{
-		hog hog(cv::imread(positive_filenames[i])(positive_roi));
-		svm::sparse_vector svec(features_to_svector(hog()));
-
-#pragma omp critical
+		// the crops are decoded ahead and their hogs computed in batches
+		image_prefetcher positive_images(positive_filenames, cfg.io_threads(), cfg.prefetch_depth(), &positive_archive);
+		const std::size_t batch_size = 256;
+		for (std::size_t first = 0; first < positive_filenames.size(); first += batch_size)
 		{
-			positives.push_back(std::move(svec));
+			const auto count = std::min(batch_size, positive_filenames.size() - first);
+			std::vector<cv::Mat> crops(count);
+			for (std::size_t i = 0; i < count; i++)
+				crops[i] = positive_images.take(first + i)(positive_roi);
 
-#pragma omp flush(processed)
-			print_progress("positives processed", ++processed, positive_filenames.size(), positive_filenames[i]);
+			if (cfg.mirror_positives() && first == 0)
+				log << to::both << "mirroring in hog space, largest deviation from the hog of the mirrored image: " << hog::flip_error(crops) << std::endl;
+
+			const auto descriptors = hog::batch(crops);
+			for (std::size_t i = 0; i < count; i++)
+			{
+				const auto features = hog::descriptor(descriptors, int(i), positive_roi.size());
+				positives.push_back(features_to_svector(features, cfg.compact_features()));
+				if (cfg.mirror_positives())
+					positives.push_back(features_to_svector(hog::flip(features), cfg.compact_features()));
+			}
+
+			processed += (unsigned long)count;
+			print_progress("positives processed", processed, positive_filenames.size(), positive_filenames[first + count - 1]);
 		}
+
+		complete("positives", &positives);
 	}
 	
 	//
 	// negatives
 	//
 	processed = 0;
-	const auto negative_filenames = files_in_folder(cfg.negative_train_path());
 	const auto hogs_per_negative = cfg.random_windows_per_negative_training_sample();
 
-#pragma omp parallel for schedule(dynamic, 50)
-	for (long i = 0; i < negative_filenames.size(); i++)
+	auto& cache = feature_cache::shared();
+	std::unique_ptr<image_prefetcher> negative_images;
+	if (!resume("negatives", negatives))
 	{
-		auto& filename = negative_filenames[i];
-		image img(cv::imread(filename));
-		auto scaled = img.scaled_images();
-
-		std::vector<svm::sparse_vector> hogs;		
-		std::set<int> windows;
-
-		// 10 windows per negative image
-		while(hogs.size() < hogs_per_negative)
+		// the threads take the images one by one, so they are consumed in the order they are decoded
+		negative_images.reset(new image_prefetcher(negative_filenames, cfg.io_threads(), cfg.prefetch_depth(), &negative_archive,
+			cache.cached(negative_filenames, cfg.cell_subdivisions())));
+#pragma omp parallel for schedule(dynamic)
+		for (long i = 0; i < negative_filenames.size(); i++)
 		{
-			auto scaled_num = rng.uniform(0, (int)scaled.size());
-			auto& scaled_img = scaled[scaled_num];
-			auto sliding_windows = scaled_img.sliding_windows();
-			auto sw_num = rng.uniform(0, (int)sliding_windows.size());
+			auto& filename = negative_filenames[i];
+			image img(cache.get(filename, cfg.cell_subdivisions(), [&]() { return negative_images->take(i); }));
+			auto scaled = img.scaled_images();
+
+			std::vector<svm::sparse_vector> hogs;		
+			std::set<int> windows;
 
-			// only add distinct windows into the hogs vector
-			// a window is identified by: ij where 
-			// i is the index of the random scaled image and 
-			// j the index of one of sliding windows of image i
-			auto id = scaled_num * 10 + sw_num;
-			if (windows.find(id) == windows.end())
+			// 10 windows per negative image
+			while(hogs.size() < hogs_per_negative)
 			{
-				svm::sparse_vector fvec(features_to_svector(sliding_windows[sw_num].features()));
-				hogs.push_back(std::move(fvec));
-				windows.insert(id);
+				auto scaled_num = rng.uniform(0, (int)scaled.size());
+				auto& scaled_img = scaled[scaled_num];
+				auto sliding_windows = scaled_img.sliding_windows();
+				auto sw_num = rng.uniform(0, (int)sliding_windows.size());
+
+				// only add distinct windows into the hogs vector
+				// a window is identified by: ij where 
+				// i is the index of the random scaled image and 
+				// j the index of one of sliding windows of image i
+				auto id = scaled_num * 10 + sw_num;
+				if (windows.find(id) == windows.end())
+				{
+					svm::sparse_vector fvec(features_to_svector(sliding_windows[sw_num].features(), cfg.compact_features()));
+					hogs.push_back(std::move(fvec));
+					windows.insert(id);
+				}
 			}
-		}
 
 #pragma omp critical
-		{			
-			std::move(hogs.begin(), hogs.end(), std::back_inserter(negatives));
+			{			
+				std::move(hogs.begin(), hogs.end(), std::back_inserter(negatives));
 
 #pragma omp flush(processed)
-			print_progress("negatives processed", ++processed, negative_filenames.size(), filename);
+				print_progress("negatives processed", ++processed, negative_filenames.size(), filename);
+			}
+		}
+
+		complete("negatives", &negatives);
+	}
+
+	//
+	// model selection
+	//
+	double svm_c = cfg.svm_c();
+	if (!cfg.svm_c_grid().empty())
+	{
+		std::ifstream selected(stages.file("c"));
+		if (done("c") && selected >> svm_c)
+			log << to::both << "resumed stage [c] (svm_c = " << svm_c << ")" << std::endl;
+		else
+		{
+			svm_c = select_c(cfg);
+			std::ofstream(stages.file("c")) << svm_c;
+			complete("c", nullptr);
 		}
 	}
 
 	//
 	// train svm
 	//
-	const auto vec_size = (svm::sparse_vector::size_type)hog::hog_size(cv::Rect(0, 0, mmp::sliding_window::width, mmp::sliding_window::height));
-	log << to::both << "training svm with " << positives.size() << " positives and " << negatives.size() << " negatives ... ";
-	model = new svm::linear_model(positives, negatives, vec_size, cfg.svm_c());
-	model->save(cfg.svm_file());
+	const auto vec_size = (svm::sparse_vector::size_type)hog::hog_size(cv::Rect(0, 0, mmp::sliding_window::width(), mmp::sliding_window::height()));
+	bool resumed = false;
+	if (done("svm"))
+	{
+		// the cascade and pca files of the model are loaded with it
+		log << to::both << "resumed stage [svm] (" << cfg.svm_file() << ") ... ";
+		resumed = load(cfg.svm_file());
+		if (!resumed)
+			log << to::both << "the stage [svm] is repeated" << std::endl;
+	}
+
+	if (!resumed)
+	{
+		if (cfg.use_pca())
+		{
+			log << to::both << "learning pca basis with " << cfg.pca_dimensions() << " dimensions ... ";
+			learn_pca(cfg.pca_dimensions());
+			log << "done" << std::endl;
+		}
+
+		log << to::both << "training svm with " << positives.size() << " positives and " << negatives.size() << " negatives ... ";
+		model = new svm::linear_model(positives, negatives, vec_size, svm_c);
+		model->set_description(geometry::active().to_string());
+		model->save(cfg.svm_file());
+		report_training();
+		calibrate_cascade();
+		save_cascade(cascade_file(cfg.svm_file()));
+		if (cfg.use_pca())
+		{
+			calibrate_pca();
+			save_pca(pca_file(cfg.svm_file()));
+		}
+	}
+
+	enable_cascade(cfg.use_cascade());
+	enable_pca(cfg.use_pca());
+	// the hard negatives are mined with the exact scores, low rank scoring is enabled once training finished
+	enable_fft(cfg.use_fft());
+	enable_quantized(cfg.use_quantized());
 	log << "done" << std::endl;		
+	complete("svm", nullptr);
 	
 	//
 	// hard mining (false positives)
 	//
-	processed = 0;
-	typedef std::pair<double, svm::sparse_vector> weighted_svec;
-	auto det_comp = [](const weighted_svec& a, const weighted_svec& b)
-	{
-		return a.first > b.first;
-	};
-	
-	std::set<weighted_svec, bool(*)(const weighted_svec& a, const weighted_svec& b)> detections(det_comp);
-
-#pragma omp parallel for schedule(dynamic, 10)
-	for (long i = 0; i < negative_filenames.size(); i++)
+	std::deque<svm::sparse_vector> mined;
+	if (!resume("mined", mined))
 	{
-		auto& filename = negative_filenames[i];
-		image img(cv::imread(filename));
-		img.detect_all(*this);
-		img.suppress_non_maximum();
+		processed = 0;
+		typedef std::pair<double, svm::sparse_vector> weighted_svec;
+		auto det_comp = [](const weighted_svec& a, const weighted_svec& b)
+		{
+			return a.first > b.first;
+		};
+		
+		std::set<weighted_svec, bool(*)(const weighted_svec& a, const weighted_svec& b)> detections(det_comp);
+
+		// with the feature cache the images of the first pass are only scored
+		negative_images.reset(new image_prefetcher(negative_filenames, cfg.io_threads(), cfg.prefetch_depth(), &negative_archive,
+			cache.cached(negative_filenames, cfg.cell_subdivisions())));
+#pragma omp parallel for schedule(dynamic)
+		for (long i = 0; i < negative_filenames.size(); i++)
+		{
+			auto& filename = negative_filenames[i];
+			image img(cache.get(filename, cfg.cell_subdivisions(), [&]() { return negative_images->take(i); }));
+			img.detect_all(*this, 0, cfg.coarse_stride(), cfg.coarse_margin());
+			img.suppress_non_maximum();
 
-		std::vector<weighted_svec> svecs;
-		svecs.reserve(img.get_detections().size());
-		for (auto& detection : img.get_detections())
-			svecs.emplace_back(detection.first, features_to_svector(detection.second->features()));
+			std::vector<weighted_svec> svecs;
+			svecs.reserve(img.get_detections().size());
+			for (auto& detection : img.get_detections())
+				svecs.emplace_back(detection.first, features_to_svector(detection.second->features(), cfg.compact_features()));
 
 #pragma omp critical
-		{
-			detections.insert(std::make_move_iterator(svecs.begin()), std::make_move_iterator(svecs.end()));
-
-			// saves RAM
-			if (detections.size() > cfg.num_hard_false_positive_retrain())
 			{
-				auto begin = detections.begin();
-				std::advance(begin, cfg.num_hard_false_positive_retrain());
-				detections.erase(begin, detections.end());
-			}
+				detections.insert(std::make_move_iterator(svecs.begin()), std::make_move_iterator(svecs.end()));
+
+				// saves RAM
+				if (detections.size() > cfg.num_hard_false_positive_retrain())
+				{
+					auto begin = detections.begin();
+					std::advance(begin, cfg.num_hard_false_positive_retrain());
+					detections.erase(begin, detections.end());
+				}
 
 #pragma omp flush(processed)
-			print_progress("false positives processed", ++processed, negative_filenames.size(), filename);
+				print_progress("false positives processed", ++processed, negative_filenames.size(), filename);
+			}
 		}
+		negative_images.reset();
+
+		for (auto& detection : detections)
+		{
+			auto& svec = const_cast<weighted_svec&>(detection).second;
+			if (cfg.mirror_hard_negatives())
+				mined.push_back(mirror(svec, cfg.compact_features()));
+
+			mined.push_back(std::move(svec));
+		}
+
+		complete("mined", &mined);
 	}
 
-	for (auto& detection : detections)
-		negatives.push_back(std::move(const_cast<weighted_svec&>(detection).second));
+	std::move(mined.begin(), mined.end(), std::back_inserter(negatives));
 
 	//
 	// hard train svm
 	//
 	log << to::both << "training svm with " << positives.size() << " positives and " << negatives.size() << " negatives ... ";
 	delete model;
-	model = new svm::linear_model(positives, negatives, vec_size, cfg.svm_c());
+	model = new svm::linear_model(positives, negatives, vec_size, svm_c);
+	model->set_description(geometry::active().to_string());
 	model->save(cfg.svm_file_hard());	
+	report_training();
+	calibrate_cascade();
+	save_cascade(cascade_file(cfg.svm_file_hard()));
+	if (cfg.use_pca())
+	{
+		calibrate_pca();
+		save_pca(pca_file(cfg.svm_file_hard()));
+	}
+	enable_low_rank(cfg.low_rank());
+	enable_fft(cfg.use_fft());
+	enable_quantized(cfg.use_quantized());
+	complete("svm_hard", nullptr);
 	log << "done" << std::endl << "training finished at: " << time_string() << std::endl;
 	log << target;
 }
@@ -201,28 +403,556 @@ double classifier::classify(const cv::Mat& mat) const
 	if (!model) throw "classifier not loaded or trained";
 	//return model->classify(features_to_svector(mat));
 
-	assert(mat.channels() == hog::dimensions && "Parameters is not a mat returned by mmp::hog!");
+	assert(mat.channels() == hog::dimensions() && "Parameters is not a mat returned by mmp::hog!");
 	assert(mat.channels() * mat.rows * mat.cols == model->get_vec_size() && "Parameter not from a sliding window (64x128)!");
 
-	return model->classify(
-		mat_iter(mat.begin<hog::vector_type>()), 
-		mat_iter(mat.end<hog::vector_type>())
-	);
+	return kernels::window_dot(model->get_weights() + 1, mat) - model->get_bias();
+}
+
+double classifier::classify(const cv::Mat& mat, double threshold) const
+{
+	// nothing can be rejected for an infinite threshold
+	if (!has_cascade() || threshold == -std::numeric_limits<double>::infinity())
+		return classify(mat);
+
+	assert(mat.channels() == hog::dimensions() && "Parameters is not a mat returned by mmp::hog!");
+	assert(mat.channels() * mat.rows * mat.cols == model->get_vec_size() && "Parameter not from a sliding window (64x128)!");
+
+	const double * weights = model->get_weights() + 1;
+	const unsigned dims = hog::dimensions();
+	double sum = -model->get_bias();
+	std::size_t i = 0;
+	for (auto& stage : cascade)
+	{
+		for (; i < stage.end; i++)
+		{
+			const auto cell = cascade_order[i];
+			const float * features = mat.ptr<float>(int(cell / mat.cols)) + (cell % mat.cols) * dims;
+			sum += kernels::cell_dot(weights + cell * dims, features, dims);
+		}
+
+		if (sum + stage.max_remaining <= threshold)
+			return -std::numeric_limits<double>::infinity();
+	}
+
+	// the partial sums are in a different order, so the surviving
+	// windows (a tiny fraction) are scored once more in the regular order
+	return classify(mat);
 }
 
-void classifier::load(const std::string& filename)
+double classifier::select_c(const inria_cfg& cfg) const
+{
+	typedef std::vector<std::reference_wrapper<const svm::sparse_vector>> svec_refs;
+	const auto& grid = cfg.svm_c_grid();
+	const auto folds = cfg.cv_folds();
+	const auto vec_size = (svm::sparse_vector::size_type)hog::hog_size(cv::Rect(0, 0, mmp::sliding_window::width(), mmp::sliding_window::height()));
+	log << to::both << "selecting svm_c by " << folds << "-fold cross validation over " << grid.size() << " values" << std::endl;
+
+	// the folds are contiguous blocks, so the windows of an image (and its mirror) stay in the same fold
+	auto in_fold = [folds](std::size_t i, std::size_t n, unsigned fold)
+	{
+		return i >= fold * n / folds && i < (fold + 1) * n / folds;
+	};
+
+	// every (c, fold) pair is trained independently, the sparse_vectors are shared (read only) by all trainings
+	std::vector<double> miss_rates(grid.size() * folds);
+	#pragma omp parallel for schedule(dynamic)
+	for (int task = 0; task < (int)miss_rates.size(); task++)
+	{
+		const auto c = grid[task / folds];
+		const unsigned fold = task % folds;
+
+		svec_refs train_positives, train_negatives;
+		std::vector<double> labels, scores;
+		for (std::size_t i = 0; i < positives.size(); i++)
+		{
+			if (!in_fold(i, positives.size(), fold))
+				train_positives.push_back(std::cref(positives[i]));
+		}
+		for (std::size_t i = 0; i < negatives.size(); i++)
+		{
+			if (!in_fold(i, negatives.size(), fold))
+				train_negatives.push_back(std::cref(negatives[i]));
+		}
+
+		svm::linear_model fold_model(train_positives, train_negatives, vec_size, c);
+		for (std::size_t i = 0; i < positives.size(); i++)
+		{
+			if (in_fold(i, positives.size(), fold))
+			{
+				labels.push_back(+1);
+				scores.push_back(fold_model.classify(positives[i]));
+			}
+		}
+		for (std::size_t i = 0; i < negatives.size(); i++)
+		{
+			if (in_fold(i, negatives.size(), fold))
+			{
+				labels.push_back(-1);
+				scores.push_back(fold_model.classify(negatives[i]));
+			}
+		}
+
+		miss_rates[task] = miss_rate(labels, scores, cfg.cv_fppw());
+	}
+
+	// the averages are compared in grid order, so ties keep the smaller (first) c
+	double best_c = grid.front();
+	double best_rate = std::numeric_limits<double>::infinity();
+	for (std::size_t i = 0; i < grid.size(); i++)
+	{
+		double rate = 0;
+		for (unsigned fold = 0; fold < folds; fold++)
+			rate += miss_rates[i * folds + fold];
+		rate /= folds;
+
+		log << to::both << "svm_c = " << grid[i] << ": miss rate " << rate << " at " << cfg.cv_fppw() << " fppw" << std::endl;
+		if (rate < best_rate)
+		{
+			best_rate = rate;
+			best_c = grid[i];
+		}
+	}
+
+	log << to::both << "selected svm_c = " << best_c << std::endl;
+	return best_c;
+}
+
+bool classifier::load(const std::string& filename)
 {
 	delete model;
 	model = new svm::linear_model(filename);	
+
+	// the description records the geometry and the feature version, models without
+	// it (or of another feature version) were trained on different features
+	geometry trained;
+	if (!geometry::parse(model->get_description(), trained))
+	{
+		log << to::both << "[" << filename << "] has no detection geometry of feature version " << geometry::feature_version
+			<< " (recorded: [" << model->get_description() << "]), it has to be retrained" << std::endl;
+		delete model;
+		model = nullptr;
+		return false;
+	}
+
+	if (trained != geometry::active())
+	{
+		log << to::both << "[" << filename << "] was trained with the detection geometry [" << trained.to_string()
+			<< "] but [" << geometry::active().to_string() << "] is configured" << std::endl;
+		delete model;
+		model = nullptr;
+		return false;
+	}
+
+	cascade_order.clear();
+	cascade.clear();
+	if (path_exists(cascade_file(filename)) && !load_cascade(cascade_file(filename)))
+		log << to::both << "invalid cascade file [" << cascade_file(filename) << "] ignored" << std::endl;
+
+	low_rank = low_rank_template();
+	fft = fft_template();
+	quantized = quantized_template();
+	pca = hog_pca();
+	pca_weights.clear();
+	if (path_exists(pca_file(filename)) && !load_pca(pca_file(filename)))
+		log << to::both << "invalid pca file [" << pca_file(filename) << "] ignored" << std::endl;
+
+	return true;
+}
+
+std::string classifier::cascade_file(const std::string& svm_file)
+{
+	return svm_file + ".cascade";
+}
+
+void classifier::calibrate_cascade()
+{
+	const std::size_t cells = std::size_t(model->get_vec_size()) / hog::dimensions();
+	const double * weights = model->get_weights() + 1;
+
+	//
+	// order cells by the energy of their weights
+	//
+	std::vector<double> energy(cells, 0);
+	for (std::size_t i = 0; i < cells * hog::dimensions(); i++)
+		energy[i / hog::dimensions()] += weights[i] * weights[i];
+
+	cascade_order.resize(cells);
+	std::iota(cascade_order.begin(), cascade_order.end(), 0);
+	std::sort(cascade_order.begin(), cascade_order.end(), [&energy](std::size_t a, std::size_t b) { return energy[a] > energy[b]; });
+
+	// stages after 1/32, 1/16, ... 1/2 of the cells
+	cascade.clear();
+	for (std::size_t end = std::max<std::size_t>(1, cells / 32); end < cells; end *= 2)
+	{
+		cascade_stage stage = { end, -std::numeric_limits<double>::infinity() };
+		cascade.push_back(stage);
+	}
+
+	//
+	// the rejection thresholds are the largest contributions of the remaining cells
+	// over all training windows (positives as well as random and hard negatives)
+	//
+	std::vector<std::size_t> rank(cells);
+	for (std::size_t i = 0; i < cells; i++)
+		rank[cascade_order[i]] = i;
+
+	std::vector<double> contributions(cells);
+	auto calibrate = [&](const svm::sparse_vector& svec)
+	{
+		std::fill(contributions.begin(), contributions.end(), 0);
+		for (auto i = svec.begin(); i != svec.end(); ++i)
+		{
+			const auto index = std::size_t(i.index() - 1);
+			contributions[rank[index / hog::dimensions()]] += weights[index] * *i;
+		}
+
+		double remaining = std::accumulate(contributions.begin(), contributions.end(), 0.0);
+		std::size_t i = 0;
+		for (auto& stage : cascade)
+		{
+			for (; i < stage.end; i++)
+				remaining -= contributions[i];
+
+			stage.max_remaining = std::max(stage.max_remaining, remaining);
+		}
+	};
+
+	for (auto& positive : positives)
+		calibrate(positive);
+	for (auto& negative : negatives)
+		calibrate(negative);
+}
+
+void classifier::save_cascade(const std::string& filename) const
+{
+	std::ofstream out(filename);
+	out.precision(17);
+
+	out << cascade_order.size() << std::endl;
+	for (auto cell : cascade_order)
+		out << cell << " ";
+	out << std::endl;
+
+	out << cascade.size() << std::endl;
+	for (auto& stage : cascade)
+		out << stage.end << " " << stage.max_remaining << std::endl;
+}
+
+bool classifier::load_cascade(const std::string& filename)
+{
+	std::ifstream in(filename);
+	std::size_t cells = 0, stages = 0;
+
+	in >> cells;
+	if (cells * hog::dimensions() != std::size_t(model->get_vec_size()))
+		return false;
+
+	cascade_order.resize(cells);
+	for (auto& cell : cascade_order)
+		in >> cell;
+
+	in >> stages;
+	cascade.resize(stages);
+	for (auto& stage : cascade)
+		in >> stage.end >> stage.max_remaining;
+
+	if (in.fail())
+	{
+		cascade_order.clear();
+		cascade.clear();
+		return false;
+	}
+
+	return true;
+}
+
+double classifier::classify_projected(const cv::Mat& projected) const
+{
+	assert(projected.channels() == pca.dimensions() && "Parameter is not a mat returned by classifier::project!");
+	assert(std::size_t(projected.rows * projected.cols * projected.channels()) == pca_weights.size());
+
+	const unsigned dims = pca.dimensions();
+	const float * weights = pca_weights.data();
+	double sum = 0;
+	for (int y = 0; y < projected.rows; y++)
+	{
+		const float * cell = projected.ptr<float>(y);
+		for (int i = 0; i < projected.cols * int(dims); i++)
+			sum += *weights++ * cell[i];
+	}
+
+	return sum - model->get_bias() + pca_max_error;
 }
 
-svm::sparse_vector classifier::features_to_svector(const cv::Mat& mat)
+std::string classifier::pca_file(const std::string& svm_file)
 {
-	assert(mat.channels() == hog::dimensions);
+	return svm_file + ".pca";
+}
+
+void classifier::learn_pca(unsigned dimensions)
+{
+	pca = hog_pca();
+
+	std::vector<float> dense;
+	auto add = [&](const svm::sparse_vector& svec)
+	{
+		dense.assign(std::size_t(svec.size()), 0);
+		for (auto i = svec.begin(); i != svec.end(); ++i)
+			dense[std::size_t(i.index() - 1)] = *i;
+
+		for (std::size_t cell = 0; cell < dense.size(); cell += hog::dimensions())
+			pca.add(dense.data() + cell);
+	};
+
+	for (auto& positive : positives)
+		add(positive);
+	for (auto& negative : negatives)
+		add(negative);
+
+	pca.learn(dimensions);
+}
+
+void classifier::project_weights()
+{
+	const std::size_t cells = std::size_t(model->get_vec_size()) / hog::dimensions();
+	const double * weights = model->get_weights() + 1;
+
+	pca_weights.resize(cells * pca.dimensions());
+	for (std::size_t cell = 0; cell < cells; cell++)
+		pca.project(weights + cell * hog::dimensions(), pca_weights.data() + cell * pca.dimensions());
+}
+
+void classifier::calibrate_pca()
+{
+	project_weights();
+
+	//
+	// the first pass must not reject windows the exact score would accept, so the
+	// projected scores are shifted by the largest error on the training windows
+	//
+	const double * weights = model->get_weights();
+	std::vector<float> dense, projected(pca.dimensions());
+	pca_max_error = 0;
+	auto calibrate = [&](const svm::sparse_vector& svec)
+	{
+		double exact = 0;
+		dense.assign(std::size_t(svec.size()), 0);
+		for (auto i = svec.begin(); i != svec.end(); ++i)
+		{
+			dense[std::size_t(i.index() - 1)] = *i;
+			exact += weights[i.index()] * *i;
+		}
+
+		double approximated = 0;
+		for (std::size_t cell = 0; cell * hog::dimensions() < dense.size(); cell++)
+		{
+			pca.project(dense.data() + cell * hog::dimensions(), projected.data());
+			for (unsigned i = 0; i < pca.dimensions(); i++)
+				approximated += pca_weights[cell * pca.dimensions() + i] * projected[i];
+		}
+
+		pca_max_error = std::max(pca_max_error, exact - approximated);
+	};
+
+	for (auto& positive : positives)
+		calibrate(positive);
+	for (auto& negative : negatives)
+		calibrate(negative);
+}
+
+void classifier::save_pca(const std::string& filename) const
+{
+	std::ofstream out(filename);
+	out.precision(9);
+
+	pca.save(out);
+	out.precision(17);
+	out << pca_max_error << std::endl;
+}
+
+bool classifier::load_pca(const std::string& filename)
+{
+	std::ifstream in(filename);
+	if (!pca.load(in))
+	{
+		pca = hog_pca();
+		return false;
+	}
+
+	in >> pca_max_error;
+	if (in.fail())
+	{
+		pca = hog_pca();
+		return false;
+	}
+
+	project_weights();
+	return true;
+}
+
+void classifier::enable_low_rank(unsigned rank)
+{
+	if (!rank)
+	{
+		low_rank = low_rank_template();
+		return;
+	}
+
+	const int rows = sliding_window::height() / hog::cellsize();
+	const int cols = sliding_window::width() / hog::cellsize();
+	assert(rows * cols * hog::dimensions() == model->get_vec_size());
+
+	low_rank = low_rank_template(model->get_weights() + 1, rows, cols, rank);
+	report_low_rank();
+}
+
+void classifier::report_low_rank() const
+{
+	//
+	// template error of every rank and (if trained) the score error on the training windows
+	//
+	const double * weights = model->get_weights() + 1;
+	to target = log >> target;
+	log << to::both << "low rank template (using rank " << low_rank.rank() << "):" << std::endl;
+
+	for (unsigned rank = 1; rank <= low_rank.max_rank(); rank++)
+	{
+		log << "rank " << rank << ": template error " << low_rank.residual(rank);
+
+		if (!positives.empty() || !negatives.empty())
+		{
+			const auto approximated = low_rank_template(weights, sliding_window::height() / hog::cellsize(), sliding_window::width() / hog::cellsize(), rank).weights();
+			double max_error = 0, sum_error = 0;
+			auto measure = [&](const svm::sparse_vector& svec)
+			{
+				double error = 0;
+				for (auto i = svec.begin(); i != svec.end(); ++i)
+					error += (weights[i.index() - 1] - approximated[std::size_t(i.index() - 1)]) * *i;
+
+				max_error = std::max(max_error, std::fabs(error));
+				sum_error += std::fabs(error);
+			};
+
+			for (auto& positive : positives)
+				measure(positive);
+			for (auto& negative : negatives)
+				measure(negative);
+
+			log << ", score error max " << max_error << " mean " << sum_error / (positives.size() + negatives.size());
+		}
+
+		log << std::endl;
+	}
+
+	log << target;
+}
+
+void classifier::enable_fft(bool enable)
+{
+	if (enable)
+		fft = fft_template(model->get_weights() + 1, sliding_window::height() / hog::cellsize(), sliding_window::width() / hog::cellsize());
+	else
+		fft = fft_template();
+}
+
+void classifier::enable_quantized(bool enable)
+{
+	if (enable)
+		quantized = quantized_template(model->get_weights() + 1, sliding_window::height() / hog::cellsize(), sliding_window::width() / hog::cellsize());
+	else
+		quantized = quantized_template();
+}
+
+cv::Mat classifier::score_map(const scaled_image& level) const
+{
+	if (!low_rank.empty() || quantized.empty() || level.get_quantized().empty())
+		return score_map((*level.get_hog())(), level.window_grid());
+
+	return subtract_bias(quantized(level.get_quantized(), level.get_quantized_scale(), level.window_grid()));
+}
+
+cv::Mat classifier::score_map(const cv::Mat& mat, cv::Size grid) const
+{
+	assert(mat.channels() == hog::dimensions() && "Parameters is not a mat returned by mmp::hog!");
+
+	if (!low_rank.empty())
+		return subtract_bias(low_rank(mat, grid));
+	else if (!quantized.empty())
+		return subtract_bias(quantized(mat, grid));
+	else if (!fft.empty() && fft.cheaper(mat.size(), grid))
+		return subtract_bias(fft(mat, grid));
+
+	return cv::Mat();
+}
+
+cv::Mat classifier::subtract_bias(cv::Mat scores) const
+{
+	for (int y = 0; y < scores.rows; y++)
+	{
+		double * score = scores.ptr<double>(y);
+		for (int x = 0; x < scores.cols; x++)
+			score[x] -= model->get_bias();
+	}
+
+	return scores;
+}
+
+svm::sparse_vector classifier::features_to_svector(const cv::Mat& mat, bool quantize)
+{
+	assert(mat.channels() == hog::dimensions());
 	
 	return svm::sparse_vector(
-		mat_iter(mat.begin<hog::vector_type>()), 
-		mat_iter(mat.end<hog::vector_type>()),
-		mat.rows * mat.cols * mat.channels()
+		mat_iter(mat, 0),
+		mat_iter(mat, mat.rows),
+		mat.rows * mat.cols * mat.channels(),
+		quantize
 	);
+}
+
+svm::sparse_vector classifier::mirror(const svm::sparse_vector& svec, bool quantize)
+{
+	const auto cells = hog::cell_rect(cv::Rect(0, 0, sliding_window::width(), sliding_window::height()));
+	std::vector<float> dense(std::size_t(svec.size()), 0);
+	for (auto i = svec.begin(); i != svec.end(); ++i)
+		dense[std::size_t(i.index() - 1)] = *i;
+
+	const cv::Mat features(cells.height, cells.width, CV_32FC(int(hog::dimensions())), dense.data());
+	return features_to_svector(hog::flip(features), quantize);
+}
+
+void classifier::report_training() const
+{
+	//
+	// accuracy on the training windows and the score error caused by 8 bit features
+	// (rounding changes each value by at most half a quantization step)
+	//
+	const double * weights = model->get_weights() + 1;
+	double l1 = 0;
+	for (svm::sparse_vector::size_type i = 0; i < model->get_vec_size(); i++)
+		l1 += std::fabs(weights[i]);
+
+	unsigned long correct = 0;
+	double max_error = 0, sum_error = 0;
+	auto measure = [&](const svm::sparse_vector& svec, bool positive)
+	{
+		if ((model->classify(svec) > 0) == positive)
+			correct++;
+
+		const double error = l1 * svec.quantization_step() / 2;
+		max_error = std::max(max_error, error);
+		sum_error += error;
+	};
+
+	for (auto& positive : positives)
+		measure(positive, true);
+	for (auto& negative : negatives)
+		measure(negative, false);
+
+	const auto total = positives.size() + negatives.size();
+	to target = log >> target;
+	log << to::both << "training accuracy: " << (total ? 100.0 * correct / total : 0) << "% of " << total << " windows" << std::endl;
+	if (max_error > 0)
+		log << "8 bit feature score error bound: max " << max_error << " mean " << sum_error / total << std::endl;
+	log << target;
 }
\ No newline at end of file
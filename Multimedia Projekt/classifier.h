@@ -1,22 +1,73 @@
 #pragma once
 #include <deque>
+#include <vector>
+#include <string>
 #include <opencv2/core/core.hpp>	// Mat
 #include <svm_light/svm.h>			// linear_model, sparse_vector
+#include "hog_pca.h"
+#include "low_rank_template.h"
+#include "fft_template.h"
+#include "quantized_template.h"
 
 namespace mmp
 {
 	class inria_cfg;
+	class scaled_image;
 
 	class classifier
 	{
+	private:
+		// a stage of the soft cascade evaluates the cells [previous end, end) of cascade_order
+		// and rejects a window if its partial sum plus max_remaining cannot exceed the threshold
+		struct cascade_stage
+		{
+			std::size_t end;
+			double max_remaining;
+		};
+
 	private:
 		svm::linear_model * model;
 
 		std::deque<svm::sparse_vector> positives;
 		std::deque<svm::sparse_vector> negatives;
 
+		bool cascade_enabled;
+		std::vector<std::size_t> cascade_order;	// cell indices sorted by weight energy
+		std::vector<cascade_stage> cascade;
+
+		bool pca_enabled;
+		hog_pca pca;
+		std::vector<float> pca_weights;	// template projected onto the pca basis (cell by cell)
+		double pca_max_error;			// largest difference of exact and projected score on the training windows
+
+		low_rank_template low_rank;
+		fft_template fft;
+		quantized_template quantized;
+
 	private:
-		static svm::sparse_vector features_to_svector(const cv::Mat& mat);
+		static svm::sparse_vector features_to_svector(const cv::Mat& mat, bool quantize = false);
+		// sparse_vector of the mirrored window (see hog::flip)
+		static svm::sparse_vector mirror(const svm::sparse_vector& svec, bool quantize = false);
+		static std::string cascade_file(const std::string& svm_file);
+
+		void calibrate_cascade();
+		void save_cascade(const std::string& filename) const;
+		bool load_cascade(const std::string& filename);
+
+		static std::string pca_file(const std::string& svm_file);
+		void learn_pca(unsigned dimensions);
+		void project_weights();
+		void calibrate_pca();
+		void save_pca(const std::string& filename) const;
+		bool load_pca(const std::string& filename);
+
+		// svm_c of the grid with the lowest cross validated miss rate (on positives and negatives)
+		double select_c(const inria_cfg& cfg) const;
+
+		void report_low_rank() const;
+		void report_training() const;
+		// scores of a score map (computed without bias) minus the bias
+		cv::Mat subtract_bias(cv::Mat scores) const;
 
 	public:
 		classifier(classifier&& rhs);
@@ -24,8 +75,38 @@ namespace mmp
 		~classifier();
 		
 		void train(const inria_cfg& cfg);
-		void load(const std::string& filename);
+		// false if the model was trained with another detection geometry or feature version
+		// (or records none), the classifier is left unloaded then
+		bool load(const std::string& filename);
+
+		// use the soft cascade (if one was calibrated) in classify(mat, threshold)
+		void enable_cascade(bool enable) { cascade_enabled = enable; }
+		bool has_cascade() const { return cascade_enabled && !cascade.empty(); }
+
+		// use the projected (PCA-HOG) template as first pass (if a basis was learned)
+		void enable_pca(bool enable) { pca_enabled = enable; }
+		bool has_pca() const { return pca_enabled && !pca.empty(); }
+		// projects every cell of a mat returned by mmp::hog onto the pca basis
+		cv::Mat project(const cv::Mat& mat) const { return pca(mat); }
+		// upper bound (with respect to the training windows) of the score of a window of a projected mat
+		double classify_projected(const cv::Mat& projected) const;
+
+		// score whole levels with a separable approximation of the template (0 = exact scoring)
+		void enable_low_rank(unsigned rank);
+		// correlate the template with the levels in the frequency domain (if cheaper than the direct correlation)
+		void enable_fft(bool enable);
+		// score levels with the int8 template on uint8 quantized features
+		void enable_quantized(bool enable);
+		bool is_quantized() const { return !quantized.empty(); }
+		// scores of all grid.width x grid.height windows (at cell stride) of a mat returned by mmp::hog
+		// an empty mat is returned if the windows of this level should be classified one by one
+		cv::Mat score_map(const cv::Mat& mat, cv::Size grid) const;
+		// as above for all windows of a level, the quantized template scores the stored uint8 copy of the level
+		cv::Mat score_map(const scaled_image& level) const;
 
 		double classify(const cv::Mat& mat) const;
+		// returns the exact score if it exceeds threshold, otherwise the
+		// window may be rejected early and -infinity is returned
+		double classify(const cv::Mat& mat, double threshold) const;
 	};
 }
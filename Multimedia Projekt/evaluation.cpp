@@ -3,6 +3,9 @@
 #include "classifier.h"
 #include "log.h"
 #include "inria.h"
+#include "scratch.h"
+#include "prefetch.h"
+#include "feature_cache.h"
 
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/core/core.hpp>	// RNG
@@ -12,13 +15,16 @@
 #include <cstring>		// memcpy
 #endif
 
-#include <algorithm>	// swap
+#include <algorithm>	// swap, sort, max
+#include <functional>	// greater
+#include <cmath>		// fabs
 #include <utility>		// move
 #include <ctime>		// time
 #include <iomanip>		// setprecision
 #include <sstream>		// stringstream
 #include <fstream>		// ofstream
 #include <limits>		// numeric_limits
+#include <omp.h>		// omp_get_max_threads, omp_get_thread_num
 
 using namespace mmp;
 
@@ -27,8 +33,8 @@ namespace
 	cv::RNG rng = std::time(nullptr);
 }
 
-annotated_image::annotated_image(const annotation::file& annotation, cv::Mat src)
-	: image(src), annotation_file(annotation)
+annotated_image::annotated_image(const annotation::file& annotation, cv::Mat src, unsigned cell_subdivisions)
+	: image(src, cell_subdivisions), annotation_file(annotation)
 {
 
 }
@@ -61,61 +67,188 @@ quantitative_evaluator::quantitative_evaluator(const inria_cfg& cfg, const class
 
 	const auto positive_roi = cv::Rect(
 		cfg.normalized_positive_test_x_offset(), cfg.normalized_positive_test_y_offset(),
-		sliding_window::width, sliding_window::height
+		sliding_window::width(), sliding_window::height()
 	);
-	const auto positives = files_in_folder(cfg.normalized_positive_test_path());
+	image_archive positive_archive, negative_archive;
+	const auto positives = dataset_files(cfg.normalized_positive_test_path(), cfg.use_archives(), positive_archive);
 	//const auto positives = files_in_folder(cfg.test_annotation_path());
-	const auto negatives = files_in_folder(cfg.negative_test_path());
+	const auto negatives = dataset_files(cfg.negative_test_path(), cfg.use_archives(), negative_archive);
 	const auto detection_threshold = -std::numeric_limits<double>::infinity();
 	unsigned long processed = 0;
 
+	// float scores of all windows to report the quantization error
+	const bool quantized = c.is_quantized();
+	std::vector<double> exact_scores;
+
 	//
 	// add positive detections
 	//
-#pragma omp parallel for schedule(static)
-	for (long i = 0; i < positives.size(); i++)
+	// the crops are decoded ahead and their hogs computed in batches
+	image_prefetcher positive_images(positives, cfg.io_threads(), cfg.prefetch_depth(), &positive_archive);
+	const std::size_t batch_size = 256;
+	for (std::size_t first = 0; first < positives.size(); first += batch_size)
 	{
-		hog hog(cv::imread(positives[i])(positive_roi));
-		auto weight = c.classify(hog());
+		const auto count = std::min(batch_size, positives.size() - first);
+		std::vector<cv::Mat> crops(count);
+		for (std::size_t i = 0; i < count; i++)
+			crops[i] = positive_images.take(first + i)(positive_roi);
 
-#pragma omp critical
+		const auto descriptors = hog::batch(crops);
+		std::vector<double> weights(count), exact(count);
+#pragma omp parallel for schedule(static)
+		for (long i = 0; i < long(count); i++)
 		{
-			labels.push_back(1);
-			scores.push_back(weight);
+			const auto features = hog::descriptor(descriptors, int(i), positive_roi.size());
 
-#pragma omp flush(processed)
-			print_progress("positives processed", ++processed, positives.size(), positives[i]);
+			// score the positives like the windows of the negatives
+			auto map = c.score_map(features, cv::Size(1, 1));
+			weights[i] = map.empty() ? c.classify(features) : map.at<double>(0, 0);
+			exact[i] = quantized ? c.classify(features) : weights[i];
 		}
+
+		labels.insert(labels.end(), count, 1);
+		scores.insert(scores.end(), weights.begin(), weights.end());
+		if (quantized)
+			exact_scores.insert(exact_scores.end(), exact.begin(), exact.end());
+
+		processed += (unsigned long)count;
+		print_progress("positives processed", processed, positives.size(), positives[first + count - 1]);
 	}
 
 	//
 	// add negative detections
 	//
 	processed = 0;
+	// the negatives are the same for every evaluated svm, the feature cache keeps their hogs
+	auto& cache = feature_cache::shared();
+	image_prefetcher negative_images(negatives, cfg.io_threads(), cfg.prefetch_depth(), &negative_archive, cache.cached(negatives, cfg.cell_subdivisions()));
+
+	// every thread appends the scores of its images to its own buffer, the images are
+	// merged in their order afterwards (so the result does not depend on the scheduling)
+	struct result_buffer
+	{
+		std::vector<double> scores;
+		std::vector<double> exact;
+	};
+	struct image_results
+	{
+		int buffer;
+		std::size_t begin, end;
+
+		image_results() : buffer(0), begin(0), end(0) { }
+		image_results(int buffer, std::size_t begin, std::size_t end) : buffer(buffer), begin(begin), end(end) { }
+	};
+	std::vector<result_buffer> buffers(omp_get_max_threads());
+	std::vector<image_results> results(negatives.size());
+
+	// every window is a detection (the threshold is -infinity), the buffers are allocated for the
+	// windows of an even share of the images at the resolution of the first one
+	if (!negatives.empty())
+	{
+		const auto first_size = negative_archive.is_open() ? negative_archive[0].size() : cv::imread(negatives.front()).size();
+		const auto per_thread = (negatives.size() + buffers.size() - 1) / buffers.size() * image::window_count(first_size, cfg.cell_subdivisions());
+		for (auto& buffer : buffers)
+		{
+			buffer.scores.reserve(per_thread);
+			if (quantized)
+				buffer.exact.reserve(per_thread);
+		}
+	}
 
 #pragma omp parallel for schedule(dynamic)
 	for (long i = 0; i < negatives.size(); i++)
 	{
-		image img(cv::imread(negatives[i]));
+		image img(cache.get(negatives[i], cfg.cell_subdivisions(), [&]() { return negative_images.take(i); }));
 		img.detect_all(c, detection_threshold/*, 1.01f*/);
 
-#pragma omp critical
+		const int thread = omp_get_thread_num();
+		auto& buffer = buffers[thread];
+		const auto begin = buffer.scores.size();
+		for (auto& detection : img.get_detections())
 		{
-			for (auto& detection : img.get_detections())
-			{
-				labels.push_back(-1);
-				scores.push_back(detection.first);
-			}
+			buffer.scores.push_back(detection.first);
+			if (quantized)
+				buffer.exact.push_back(c.classify(detection.second->features()));
+		}
+		results[i] = image_results(thread, begin, buffer.scores.size());
 
+#pragma omp critical
+		{
 #pragma omp flush(processed)
 			print_progress("negatives processed", ++processed, negatives.size(), negatives[i]);
 		}
 	}
 
+	std::size_t detections = 0;
+	for (auto& result : results)
+		detections += result.end - result.begin;
+
+	labels.insert(labels.end(), detections, -1);
+	scores.reserve(scores.size() + detections);
+	if (quantized)
+		exact_scores.reserve(exact_scores.size() + detections);
+	for (auto& result : results)
+	{
+		const auto& buffer = buffers[result.buffer];
+		scores.insert(scores.end(), buffer.scores.begin() + result.begin, buffer.scores.begin() + result.end);
+		if (quantized)
+			exact_scores.insert(exact_scores.end(), buffer.exact.begin() + result.begin, buffer.exact.begin() + result.end);
+	}
+	buffers.clear();
+
+	// a run at one resolution only allocates while the pools warm up
+	const auto memory = scratch::counters();
+	log << to::both << "scratch pools: " << memory.allocations << " allocations (" << memory.bytes / (1 << 20)
+		<< " MB), " << memory.extractors << " vl_hog objects" << std::endl;
+	if (cache.enabled())
+	{
+		const auto cached = cache.counters();
+		log << to::both << "feature cache: " << cached.hits << " hits, " << cached.misses << " misses, " << cached.memory_bytes / (1 << 20)
+			<< " MB in memory, " << cached.spilled_bytes / (1 << 20) << " MB spilled" << std::endl;
+	}
+
+	if (quantized)
+	{
+		double max_error = 0, sum_error = 0;
+		for (std::size_t i = 0; i < scores.size(); i++)
+		{
+			max_error = std::max(max_error, std::fabs(scores[i] - exact_scores[i]));
+			sum_error += std::fabs(scores[i] - exact_scores[i]);
+		}
+
+		log << to::both << "quantization score error: max " << max_error << " mean " << (scores.empty() ? 0 : sum_error / scores.size()) << std::endl;
+		for (double fppw = 1e-3; fppw > 1e-6; fppw /= 10)
+			log << "miss rate at " << fppw << " FPPW: " << miss_rate(labels, scores, fppw) << " (float: " << miss_rate(labels, exact_scores, fppw) << ")" << std::endl;
+	}
+
 	log << to::both << "evaluation finished at: " << time_string() << std::endl;
 	log << target;
 }
 
+double mmp::miss_rate(const std::vector<double>& labels, const std::vector<double>& scores, double fppw)
+{
+	std::vector<double> positives, negatives;
+	for (std::size_t i = 0; i < labels.size(); i++)
+		(labels[i] > 0 ? positives : negatives).push_back(scores[i]);
+
+	if (positives.empty())
+		return 0;
+
+	// the threshold lets through fppw * negatives.size() false positives
+	std::sort(negatives.begin(), negatives.end(), std::greater<double>());
+	const auto allowed = std::size_t(fppw * negatives.size());
+	const double threshold = allowed < negatives.size() ? negatives[allowed] : -std::numeric_limits<double>::infinity();
+
+	std::size_t misses = 0;
+	for (auto score : positives)
+	{
+		if (score <= threshold)
+			misses++;
+	}
+
+	return double(misses) / positives.size();
+}
+
 mat_plot::mat_plot()
 	: engine(nullptr), labels(nullptr), scores(nullptr)
 {
@@ -248,8 +381,8 @@ qualitative_evaluator::qualitative_evaluator(const mmp::inria_cfg& cfg, const cl
 			if (path_exists(img_path))
 			{
 				auto img = cv::imread(img_path);
-				mmp::qualitative_evaluator::show_detections(c, annotation, img.clone(), "normal classifier");
-				mmp::qualitative_evaluator::show_detections(c_hard, annotation, img.clone(), "hard classifier");
+				mmp::qualitative_evaluator::show_detections(cfg, c, annotation, img.clone(), "normal classifier");
+				mmp::qualitative_evaluator::show_detections(cfg, c_hard, annotation, img.clone(), "hard classifier");
 			}
 			else
 				log << to::both << "error loading image: " << img_path << " (file does not exist)" << std::endl;
@@ -260,10 +393,10 @@ qualitative_evaluator::qualitative_evaluator(const mmp::inria_cfg& cfg, const cl
 	log << target;
 }
 
-void qualitative_evaluator::show_detections(const classifier& c, annotation::file& ann, cv::Mat src, const std::string& windowname)
+void qualitative_evaluator::show_detections(const inria_cfg& cfg, const classifier& c, annotation::file& ann, cv::Mat src, const std::string& windowname)
 {
-	auto img = mmp::annotated_image(ann, src);
-	img.detect_all(c);
+	auto img = mmp::annotated_image(ann, src, cfg.cell_subdivisions());
+	img.detect_all(c, 0, cfg.coarse_stride(), cfg.coarse_margin());
 	img.suppress_non_maximum();
 
 	for (auto& d : img.get_detections())
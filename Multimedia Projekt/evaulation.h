@@ -16,7 +16,7 @@ namespace mmp
 		annotation::file annotation_file;
 
 	public:
-		annotated_image(const annotation::file& annotation, cv::Mat image);
+		annotated_image(const annotation::file& annotation, cv::Mat image, unsigned cell_subdivisions = 1);
 
 		std::vector<cv::Rect> get_objects_boxes() const;
 		bool is_valid_detection(const cv::Rect& rect) const;
@@ -46,6 +46,9 @@ namespace mmp
 		void show(const std::string& title = "") const;
 	};
 
+	// miss rate at the given false positives per window (labels are +1/-1)
+	double miss_rate(const std::vector<double>& labels, const std::vector<double>& scores, double fppw);
+
 	class quantitative_evaluator
 	{
 	private:
@@ -65,6 +68,6 @@ namespace mmp
 	public:
 		qualitative_evaluator(const mmp::inria_cfg& cfg, const classifier& c_normal, const classifier& c_hard);
 
-		static void show_detections(const classifier& c, annotation::file& ann, cv::Mat img, const std::string& windowname = "");
+		static void show_detections(const inria_cfg& cfg, const classifier& c, annotation::file& ann, cv::Mat img, const std::string& windowname = "");
 	};
 }
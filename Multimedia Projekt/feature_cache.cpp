@@ -0,0 +1,181 @@
+#include "feature_cache.h"
+#include "geometry.h"
+#include "scratch.h"
+#include <cstdio>		// remove
+#include <cstring>		// memcpy
+#include <memory>		// make_shared
+#include <utility>		// move
+using namespace mmp;
+
+feature_cache::feature_cache()
+	: budget(0), spill_size(0)
+{
+	stats.hits = stats.misses = stats.memory_bytes = stats.spilled_bytes = 0;
+}
+
+feature_cache::~feature_cache()
+{
+	spill_region.reset();
+	spill_mapping = boost::interprocess::file_mapping();
+	if (spill.is_open())
+	{
+		spill.close();
+		std::remove(spill_file.c_str());
+	}
+}
+
+feature_cache& feature_cache::shared()
+{
+	static feature_cache cache;
+	return cache;
+}
+
+void feature_cache::configure(std::size_t megabytes, const std::string& file)
+{
+	budget = megabytes << 20;
+	spill_file = file;
+}
+
+std::string feature_cache::key(const std::string& filename, unsigned cell_subdivisions)
+{
+	return filename + '|' + geometry::active().to_string() + '|' + std::to_string(cell_subdivisions);
+}
+
+std::vector<bool> feature_cache::cached(const std::vector<std::string>& filenames, unsigned cell_subdivisions)
+{
+	std::vector<bool> found;
+	if (!enabled())
+		return found;
+
+	found.reserve(filenames.size());
+#pragma omp critical(feature_cache)
+	for (auto& filename : filenames)
+		found.push_back(entries.count(key(filename, cell_subdivisions)) > 0);
+
+	return found;
+}
+
+image feature_cache::get(const std::string& filename, unsigned cell_subdivisions, const std::function<cv::Mat()>& decode)
+{
+	if (!enabled())
+		return image(decode(), cell_subdivisions);
+
+	const auto k = key(filename, cell_subdivisions);
+	std::vector<scaled_image> grids;
+	if (load(k, grids))
+		return image(std::move(grids));
+
+	image img(decode(), cell_subdivisions);
+	store(k, img);
+	return img;
+}
+
+bool feature_cache::load(const std::string& k, std::vector<scaled_image>& grids)
+{
+	//
+	// entries are neither changed nor removed once inserted (and the nodes of the map don't move), so
+	// only the lookup and renewing the mapping of the spill file are locked, the features are copied
+	// outside of it
+	//
+	const entry * e = nullptr;
+	std::shared_ptr<const boost::interprocess::mapped_region> region;
+
+#pragma omp critical(feature_cache)
+	{
+		auto i = entries.find(k);
+		if (i != entries.end())
+			e = &i->second;
+
+		(e ? stats.hits : stats.misses)++;
+		if (e && e->spilled)
+		{
+			// the mapping is renewed once the spill file has grown beyond it
+			if (!spill_region || e->spill_offset >= spill_region->get_size())
+			{
+				spill.flush();
+				spill_mapping = boost::interprocess::file_mapping(spill_file.c_str(), boost::interprocess::read_only);
+				spill_region = std::make_shared<const boost::interprocess::mapped_region>(spill_mapping, boost::interprocess::read_only);
+			}
+
+			region = spill_region;
+		}
+	}
+
+	if (!e)
+		return false;
+
+	const float * values = e->spilled
+		? reinterpret_cast<const float *>(static_cast<const char *>(region->get_address()) + e->spill_offset)
+		: e->features.data();
+
+	grids.reserve(e->grids.size());
+	for (auto& g : e->grids)
+	{
+		const std::size_t size = std::size_t(g.cells.area()) * hog::dimensions();
+		hog::array_type features = scratch::take(size);
+		std::memcpy(features.data(), values, size * sizeof(float));
+		values += size;
+		grids.emplace_back(std::make_shared<hog>(std::move(features), g.cells), g.size, g.offset, g.scale);
+	}
+
+	return true;
+}
+
+void feature_cache::store(const std::string& k, const image& img)
+{
+	//
+	// the hogs of all grids are copied into one block
+	//
+	entry e;
+	e.spilled = false;
+	e.spill_offset = 0;
+	std::size_t size = 0;
+	for (auto& s : img.scaled_images())
+	{
+		const cv::Mat features = (*s.get_hog())();
+		const grid g = { s.get_scale(), s.get_offset(), s.get_size(), features.size() };
+		e.grids.push_back(g);
+		size += features.total() * features.channels();
+	}
+
+	e.features.resize(size);
+	float * values = e.features.data();
+	for (auto& s : img.scaled_images())
+	{
+		const cv::Mat features = (*s.get_hog())();
+		std::memcpy(values, features.ptr<float>(), features.total() * features.channels() * sizeof(float));
+		values += features.total() * features.channels();
+	}
+
+#pragma omp critical(feature_cache)
+	if (!entries.count(k))
+	{
+		const std::size_t bytes = size * sizeof(float);
+		if (stats.memory_bytes + bytes <= budget)
+		{
+			stats.memory_bytes += bytes;
+			entries.emplace(k, std::move(e));
+		}
+		else
+		{
+			if (!spill.is_open())
+				spill.open(spill_file, std::ios::binary | std::ios::trunc);
+
+			// images not fitting into an unwritable spill file are extracted again
+			if (spill.write(reinterpret_cast<const char *>(e.features.data()), std::streamsize(bytes)))
+			{
+				e.spilled = true;
+				e.spill_offset = spill_size;
+				hog::array_type().swap(e.features);
+				spill_size += bytes;
+				stats.spilled_bytes += bytes;
+				entries.emplace(k, std::move(e));
+			}
+		}
+	}
+}
+
+feature_cache::statistics feature_cache::counters() const
+{
+	return stats;
+}
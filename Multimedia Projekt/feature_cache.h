@@ -0,0 +1,83 @@
+#pragma once
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <opencv2/core/core.hpp>	// Mat, Size, Point
+#include <unordered_map>
+#include <functional>	// function
+#include <memory>		// shared_ptr
+#include <fstream>		// ofstream
+#include <vector>
+#include <string>
+#include <cstdint>		// uint64_t
+#include "image.h"
+
+namespace mmp
+{
+	// hogs of all grids of the images processed so far, keyed by image file, detection geometry and cell
+	// subdivisions. later passes over the same images (hard mining, repeated evaluations) take the grids from
+	// here and only score them. features are kept in memory up to a budget, beyond it they are appended
+	// to a file, which is memory-mapped for reading
+	class feature_cache
+	{
+	public:
+		struct statistics
+		{
+			unsigned long long hits;
+			unsigned long long misses;
+			unsigned long long memory_bytes;
+			unsigned long long spilled_bytes;
+		};
+
+	private:
+		struct grid
+		{
+			float scale;
+			cv::Point offset;
+			cv::Size size;	// in pixels
+			cv::Size cells;
+		};
+
+		struct entry
+		{
+			std::vector<grid> grids;
+			std::vector<float> features;	// of all grids, empty if spilled
+			bool spilled;
+			std::uint64_t spill_offset;
+		};
+
+		std::size_t budget;		// bytes
+		statistics stats;
+		std::unordered_map<std::string, entry> entries;
+
+		std::string spill_file;
+		std::ofstream spill;
+		std::uint64_t spill_size;
+		boost::interprocess::file_mapping spill_mapping;
+		// shared with the loads copying from it, so renewing the mapping doesn't unmap it under them
+		std::shared_ptr<const boost::interprocess::mapped_region> spill_region;
+
+		feature_cache();
+		feature_cache(const feature_cache&);
+		feature_cache& operator=(const feature_cache&);
+		~feature_cache();
+
+		static std::string key(const std::string& filename, unsigned cell_subdivisions);
+		bool load(const std::string& key, std::vector<scaled_image>& grids);
+		void store(const std::string& key, const image& img);
+
+	public:
+		// of the process, disabled (every image is built) until it is configured
+		static feature_cache& shared();
+		// budget in megabytes (0 disables the cache), the spill file is removed at exit
+		void configure(std::size_t megabytes, const std::string& spill_file);
+		bool enabled() const { return budget > 0; }
+
+		// for each of the files if it is cached (to skip decoding it), empty if the cache is disabled
+		std::vector<bool> cached(const std::vector<std::string>& filenames, unsigned cell_subdivisions);
+
+		// the cached image or the image of decode() if it isn't cached yet (and then added to the cache)
+		image get(const std::string& filename, unsigned cell_subdivisions, const std::function<cv::Mat()>& decode);
+
+		statistics counters() const;
+	};
+}
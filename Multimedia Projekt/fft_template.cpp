@@ -0,0 +1,139 @@
+#include "fft_template.h"
+#include "hog.h"
+#include <cmath>	// log
+#include <cassert>
+using namespace mmp;
+
+fft_template::fft_template()
+	: rows(0), cols(0)
+{
+
+}
+
+fft_template::fft_template(const double * weights, int rows, int cols)
+	: rows(rows), cols(cols), cache(std::make_shared<cache_type>())
+{
+	for (unsigned c = 0; c < hog::dimensions(); c++)
+	{
+		cv::Mat plane(rows, cols, CV_32FC1);
+		for (int y = 0; y < rows; y++)
+		{
+			for (int x = 0; x < cols; x++)
+				plane.at<float>(y, x) = float(weights[(y * cols + x) * hog::dimensions() + c]);
+		}
+
+		planes.push_back(plane);
+	}
+}
+
+std::shared_ptr<const fft_template::spectra_type> fft_template::spectra(cv::Size size) const
+{
+	const auto key = std::make_pair(size.height, size.width);
+	std::shared_ptr<const spectra_type> result;
+
+#pragma omp critical(fft_template_cache)
+	{
+		auto i = cache->entries.find(key);
+		if (i != cache->entries.end())
+		{
+			i->second.last_use = ++cache->uses;
+			result = i->second.spectra;
+		}
+	}
+
+	if (result)
+		return result;
+
+	// the transforms run outside of the lock, so the other threads keep scoring
+	auto s = std::make_shared<spectra_type>();
+	for (auto& plane : planes)
+	{
+		cv::Mat padded = cv::Mat::zeros(size, CV_32FC1);
+		plane.copyTo(padded(cv::Rect(0, 0, cols, rows)));
+
+		cv::Mat spectrum;
+		cv::dft(padded, spectrum, 0, rows);
+		s->push_back(spectrum);
+	}
+
+#pragma omp critical(fft_template_cache)
+	{
+		// if another thread transformed the same size meanwhile, its spectra are kept
+		auto i = cache->entries.find(key);
+		if (i == cache->entries.end())
+		{
+			if (cache->entries.size() >= max_cached_sizes)
+			{
+				auto oldest = cache->entries.begin();
+				for (auto j = cache->entries.begin(); j != cache->entries.end(); ++j)
+				{
+					if (j->second.last_use < oldest->second.last_use)
+						oldest = j;
+				}
+
+				cache->entries.erase(oldest);
+			}
+
+			cache_entry entry = { s, 0 };
+			i = cache->entries.insert(std::make_pair(key, entry)).first;
+		}
+
+		i->second.last_use = ++cache->uses;
+		result = i->second.spectra;
+	}
+
+	return result;
+}
+
+bool fft_template::cheaper(cv::Size level, cv::Size grid) const
+{
+	const double dims = hog::dimensions();
+	const double n = double(cv::getOptimalDFTSize(level.width)) * cv::getOptimalDFTSize(level.height);
+
+	// a real fft costs about 2.5 n log2(n) flops, a (packed) spectrum multiply-add 4 n
+	// (one forward transform per channel and a single inverse transform)
+	const double fft = (dims + 1) * 2.5 * n * std::log(n) / std::log(2.0) + dims * 4 * n;
+	const double direct = 2.0 * grid.area() * rows * cols * dims;
+
+	return fft < direct;
+}
+
+cv::Mat fft_template::operator()(const cv::Mat& features, cv::Size grid) const
+{
+	assert(features.channels() == hog::dimensions());
+	assert(features.rows >= grid.height + rows - 1 && features.cols >= grid.width + cols - 1);
+
+	// the correlation is circular, but the windows never reach the padding
+	const cv::Size size(cv::getOptimalDFTSize(features.cols), cv::getOptimalDFTSize(features.rows));
+	const auto template_spectra = spectra(size);
+
+	const unsigned dims = hog::dimensions();
+	cv::Mat plane(size, CV_32FC1), spectrum, product, sum;
+	for (unsigned c = 0; c < dims; c++)
+	{
+		plane.setTo(cv::Scalar(0));
+		for (int y = 0; y < features.rows; y++)
+		{
+			const float * f = features.ptr<float>(y) + c;
+			float * p = plane.ptr<float>(y);
+			for (int x = 0; x < features.cols; x++)
+				p[x] = f[x * dims];
+		}
+
+		cv::dft(plane, spectrum, 0, features.rows);
+		// conjugating the template spectrum turns the convolution into a correlation
+		cv::mulSpectrums(spectrum, (*template_spectra)[c], product, 0, true);
+
+		if (sum.empty())
+			sum = product.clone();
+		else
+			sum += product;
+	}
+
+	cv::Mat correlation;
+	cv::dft(sum, correlation, cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT, grid.height);
+
+	cv::Mat scores;
+	correlation(cv::Rect(0, 0, grid.width, grid.height)).convertTo(scores, CV_64FC1);
+	return scores;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <opencv2/core/core.hpp>	// Mat, Size
+#include <vector>
+#include <map>
+#include <memory>	// shared_ptr
+#include <utility>	// pair
+
+namespace mmp
+{
+	// correlates a linear template of (rows x cols) hog cells with whole levels in the frequency domain
+	class fft_template
+	{
+	private:
+		typedef std::vector<cv::Mat> spectra_type;	// one spectrum per hog channel
+		struct cache_entry
+		{
+			std::shared_ptr<const spectra_type> spectra;
+			unsigned long last_use;
+		};
+		struct cache_type
+		{
+			std::map<std::pair<int, int>, cache_entry> entries;
+			unsigned long uses;			// value initialized (0) by make_shared
+		};
+
+		// the optimal dft sizes of the levels of a dataset repeat, but the least recently
+		// used spectra are dropped once this many sizes are cached
+		static const std::size_t max_cached_sizes = 64;
+
+		int rows;
+		int cols;
+		std::vector<cv::Mat> planes;		// template channels (rows x cols)
+		std::shared_ptr<cache_type> cache;	// template spectra by padded level size
+
+	private:
+		// held by the caller, so an evicted entry stays valid until it is no longer used
+		std::shared_ptr<const spectra_type> spectra(cv::Size size) const;
+
+	public:
+		fft_template();
+		// weights are stored like a window returned by mmp::hog (row by row, cell by cell)
+		fft_template(const double * weights, int rows, int cols);
+
+		bool empty() const { return planes.empty(); }
+
+		// cost model: true if correlating a level of the given size (in cells) in the frequency domain
+		// is cheaper than the direct correlation of grid.width x grid.height windows
+		bool cheaper(cv::Size level, cv::Size grid) const;
+
+		// scores (without bias) of every window of grid.width x grid.height cell positions of a mat returned by mmp::hog
+		cv::Mat operator()(const cv::Mat& features, cv::Size grid) const;
+	};
+}
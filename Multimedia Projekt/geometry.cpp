@@ -0,0 +1,57 @@
+#include "geometry.h"
+#include <sstream>	// stringstream
+using namespace mmp;
+
+geometry geometry::active_geometry;
+
+geometry::geometry()
+	: variant(UoCCTi), cellsize(8), orientations(9), window_width(64), window_height(128), scales_per_octave(5)
+{
+
+}
+
+bool geometry::valid() const
+{
+	return cellsize > 0 && orientations > 0 && scales_per_octave > 0
+		&& window_width > 0 && window_height > 0
+		&& window_width % cellsize == 0 && window_height % cellsize == 0;
+}
+
+std::string geometry::to_string() const
+{
+	std::stringstream str;
+	str << (variant == UoCCTi ? "uoccti" : "dalaltriggs") << " " << cellsize << " " << orientations << " "
+		<< window_width << "x" << window_height << " " << scales_per_octave << " f" << feature_version;
+	return str.str();
+}
+
+bool geometry::parse(const std::string& s, geometry& g)
+{
+	std::stringstream str(s);
+	std::string name;
+	char x, f;
+	unsigned version;
+	geometry parsed;
+	str >> name >> parsed.cellsize >> parsed.orientations >> parsed.window_width >> x >> parsed.window_height >> parsed.scales_per_octave >> f >> version;
+	if (str.fail() || x != 'x' || f != 'f' || version != feature_version || (name != "uoccti" && name != "dalaltriggs"))
+		return false;
+
+	parsed.variant = (name == "uoccti") ? UoCCTi : DalalTriggs;
+	if (!parsed.valid())
+		return false;
+
+	g = parsed;
+	return true;
+}
+
+bool geometry::operator==(const geometry& rhs) const
+{
+	return variant == rhs.variant && cellsize == rhs.cellsize && orientations == rhs.orientations
+		&& window_width == rhs.window_width && window_height == rhs.window_height
+		&& scales_per_octave == rhs.scales_per_octave;
+}
+
+void geometry::select(const geometry& g)
+{
+	active_geometry = g;
+}
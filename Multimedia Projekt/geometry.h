@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+
+namespace mmp
+{
+	// hog parameters, detection window and pyramid density of the detector
+	struct geometry
+	{
+		enum hog_variant
+		{
+			DalalTriggs,
+			UoCCTi
+		};
+
+		hog_variant variant;
+		unsigned cellsize;
+		unsigned orientations;
+		int window_width;
+		int window_height;
+		unsigned scales_per_octave;
+
+		// the configuration this project was developed with (uoccti 8 9 64x128 5)
+		geometry();
+
+		// version of the feature extraction, recorded with the geometry: models (and cached
+		// features) of another version do not parse. raise it whenever the features change
+		static const unsigned feature_version = 2;
+
+		unsigned dimensions() const { return (variant == UoCCTi) ? (4 + 3 * orientations) : (4 * orientations); }
+		bool valid() const;
+
+		// "<variant> <cellsize> <orientations> <width>x<height> <scales_per_octave> f<feature_version>", as recorded in the model files
+		std::string to_string() const;
+		static bool parse(const std::string& str, geometry& g);
+
+		bool operator==(const geometry& rhs) const;
+		bool operator!=(const geometry& rhs) const { return !(*this == rhs); }
+
+		// the geometry used by hog, sliding_window and image,
+		// it has to be selected before the first image is processed
+		// (inline, the hog accessors are called in the inner loops)
+		static const geometry& active() { return active_geometry; }
+		static void select(const geometry& g);
+
+	private:
+		static geometry active_geometry;
+	};
+}
@@ -1,45 +1,220 @@
 #include "hog.h"
+#include "kernels.h"
+#include "scratch.h"
 #include <vl/hog.h>
-#include <algorithm> // max
+#include <algorithm> // max, fill
+#include <utility>	// move
+#include <cmath>	// atan2, floor, fmod, sqrt, fabs
 using namespace mmp;
 
 hog::array_type hog::vlarray_to_cvstylevec(const array_type& vlarray, array_type::size_type height, array_type::size_type width, array_type::size_type dimensions)
 {
 	std::vector<float> cstylevec(height * width * dimensions);
-	for (array_type::size_type y = 0; y < height; y++)
+	kernels::interleave(vlarray.data(), cstylevec.data(), height * width, unsigned(dimensions));
+
+	return cstylevec;
+}
+
+hog::hog(const gradient_field& field, const cv::Rect& roi)
+{
+	auto vl = (VlHog *)scratch::extractor(roi.width, roi.height);
+
+	// vl_hog expects contiguous arrays (a roi spanning whole rows already is)
+	cv::Mat modulus = field.modulus(roi), angle = field.angle(roi);
+	if (modulus.isContinuous())
+	{
+		vl_hog_put_polar_field(vl, modulus.ptr<float>(), angle.ptr<float>(), VL_TRUE, roi.width, roi.height, cellsize());
+		extract(vl);
+		return;
+	}
+
+	scratch::buffer modulus_copy(roi.area()), angle_copy(roi.area());
+	modulus.copyTo(cv::Mat(roi.height, roi.width, CV_32FC1, modulus_copy.data()));
+	angle.copyTo(cv::Mat(roi.height, roi.width, CV_32FC1, angle_copy.data()));
+	vl_hog_put_polar_field(vl, modulus_copy.data(), angle_copy.data(), VL_TRUE, roi.width, roi.height, cellsize());
+	extract(vl);
+}
+
+hog::gradient_field hog::gradients(const cv::Mat& src)
+{
+	gradient_field field;
+	gradients(src, field);
+	return field;
+}
+
+void hog::gradients(const cv::Mat& src, gradient_field& field)
+{
+	assert(src.type() == CV_8UC1 || src.type() == CV_8UC3);
+	const int channels = src.channels();
+	const float step = float(CV_PI / orientations());
+
+	field.modulus.create(src.rows, src.cols, CV_32FC1);
+	field.angle.create(src.rows, src.cols, CV_32FC1);
+
+	// like vl_hog_put_image: central differences of the channel with the largest gradient, the
+	// orientation is assigned to the closest bin. the border pixels have no gradient (put_image skips them)
+	for (int y = 0; y < src.rows; y++)
 	{
-		for (array_type::size_type x = 0; x < width; x++)
+		float * modulus = field.modulus.ptr<float>(y);
+		float * angle = field.angle.ptr<float>(y);
+		if (y == 0 || y == src.rows - 1)
+		{
+			std::fill(modulus, modulus + src.cols, 0.f);
+			std::fill(angle, angle + src.cols, 0.f);
+			continue;
+		}
+
+		const uchar * above = src.ptr<uchar>(y - 1);
+		const uchar * row = src.ptr<uchar>(y);
+		const uchar * below = src.ptr<uchar>(y + 1);
+		modulus[0] = angle[0] = 0;
+		modulus[src.cols - 1] = angle[src.cols - 1] = 0;
+
+		for (int x = 1; x < src.cols - 1; x++)
 		{
-			for (array_type::size_type c = 0; c < dimensions; c++)
-				cstylevec[y * width * dimensions + x * dimensions + c] = vlarray[c * width * height + y * width + x];
+			const int left = (x - 1) * channels;
+			const int right = (x + 1) * channels;
+
+			float gradx = 0, grady = 0, norm2 = 0;
+			for (int c = 0; c < channels; c++)
+			{
+				const float gx = float(row[right + c]) - row[left + c];
+				const float gy = float(below[x * channels + c]) - above[x * channels + c];
+				if (gx * gx + gy * gy > norm2)
+				{
+					gradx = gx;
+					grady = gy;
+					norm2 = gx * gx + gy * gy;
+				}
+			}
+
+			if (norm2 <= 0)
+			{
+				modulus[x] = angle[x] = 0;
+				continue;
+			}
+
+			const float bin = std::floor(std::atan2(grady, gradx) / step + 0.5f);
+			modulus[x] = std::sqrt(norm2);
+			angle[x] = std::fmod(bin * step + float(2 * CV_PI), float(2 * CV_PI));
 		}
 	}
+}
 
-	return cstylevec;
+cv::Mat hog::batch(const std::vector<cv::Mat>& crops)
+{
+	if (crops.empty())
+		return cv::Mat();
+
+	const auto size = crops.front().size();
+	const auto cells = cell_rect(cv::Rect(0, 0, size.width, size.height));
+	const auto plane_size = std::size_t(cells.width) * cells.height;
+	cv::Mat descriptors((int)crops.size(), int(plane_size * dimensions()), CV_32FC1);
+
+#pragma omp parallel for schedule(static)
+	for (long i = 0; i < long(crops.size()); i++)
+	{
+		assert(crops[i].size() == size && "the crops of a batch must have the same size");
+		auto vl = (VlHog *)scratch::extractor(size.width, size.height);
+
+		// the gradients are computed from the interleaved crop, so there is no conversion to vl's planar layout
+		scratch::buffer modulus(size.area()), angle(size.area());
+		gradient_field field;
+		field.modulus = cv::Mat(size, CV_32FC1, modulus.data());
+		field.angle = cv::Mat(size, CV_32FC1, angle.data());
+		gradients(crops[i], field);
+		vl_hog_put_polar_field(vl, modulus.data(), angle.data(), VL_TRUE, size.width, size.height, cellsize());
+		assert(vl_hog_get_width(vl) == cells.width && vl_hog_get_height(vl) == cells.height);
+
+		scratch::buffer planes(plane_size * dimensions());
+		vl_hog_extract(vl, planes.data());
+		kernels::interleave(planes.data(), descriptors.ptr<float>(int(i)), plane_size, dimensions());
+	}
+
+	return descriptors;
 }
 
-hog::hog(const cv::Mat& src)
-	: _hog(vl_hog_new(variant == DalalTriggs ? VlHogVariant::VlHogVariantDalalTriggs : VlHogVariant::VlHogVariantUoctti, orientations, VL_FALSE))
+cv::Mat hog::descriptor(const cv::Mat& batch, int i, cv::Size crop_size)
 {
-	assert(src.type() == CV_8UC1 || src.type() == CV_8UC3);
-	auto img_converted = cvmat_to_vlarray<uchar>(src);
-	vl_hog_put_image((VlHog *)_hog, img_converted.data(), src.cols, src.rows, src.channels(), cellsize);
-	hog_width = vl_hog_get_width((VlHog *)_hog);
-	hog_height = vl_hog_get_height((VlHog *)_hog);
+	return batch.row(i).reshape(int(dimensions()), cell_rect(cv::Rect(0, 0, crop_size.width, crop_size.height)).height);
+}
+
+cv::Mat hog::flip(const cv::Mat& features)
+{
+	assert(features.type() == CV_32FC(int(dimensions())));
+	const int dims = int(dimensions());
+	const vl_index * permutation = vl_hog_get_permutation((VlHog *)scratch::extractor(0, 0));
+
+	cv::Mat flipped(features.rows, features.cols, features.type());
+	for (int y = 0; y < features.rows; y++)
+	{
+		const float * in = features.ptr<float>(y);
+		float * out = flipped.ptr<float>(y);
+		for (int x = 0; x < features.cols; x++)
+		{
+			const float * cell = in + (features.cols - 1 - x) * dims;
+			for (int k = 0; k < dims; k++)
+				out[x * dims + k] = cell[permutation[k]];
+		}
+	}
+
+	return flipped;
+}
+
+float hog::flip_error(const std::vector<cv::Mat>& crops)
+{
+	std::vector<cv::Mat> flipped_crops(crops.size());
+	for (std::size_t i = 0; i < crops.size(); i++)
+		cv::flip(crops[i], flipped_crops[i], 1);
+
+	const auto descriptors = batch(crops);
+	const auto flipped_descriptors = batch(flipped_crops);
+	float max_error = 0;
+	for (std::size_t i = 0; i < crops.size(); i++)
+	{
+		const auto size = crops[i].size();
+		const auto flipped = flip(descriptor(descriptors, int(i), size));
+		const auto expected = descriptor(flipped_descriptors, int(i), size);
+		for (int y = 0; y < flipped.rows; y++)
+		{
+			const float * a = flipped.ptr<float>(y);
+			const float * b = expected.ptr<float>(y);
+			for (int j = 0; j < flipped.cols * flipped.channels(); j++)
+				max_error = std::max(max_error, std::fabs(a[j] - b[j]));
+		}
+	}
+
+	return max_error;
+}
+
+hog::hog(array_type&& features, cv::Size cells)
+	: hog_converted_data(std::move(features)), hog_width(cells.width), hog_height(cells.height)
+{
+	assert(hog_converted_data.size() == std::size_t(cells.area()) * dimensions());
+	hog_glyph_size = vl_hog_get_glyph_size((VlHog *)scratch::extractor(0, 0));
+	hog_converted = cv::Mat(cells.height, cells.width, CV_32FC(int(dimensions())), hog_converted_data.data());
+}
+
+void hog::extract(void * vl)
+{
+	hog_width = vl_hog_get_width((VlHog *)vl);
+	hog_height = vl_hog_get_height((VlHog *)vl);
 	assert(hog_width && hog_height);
-	assert(dimensions == vl_hog_get_dimension((VlHog *)_hog));
+	assert(dimensions() == vl_hog_get_dimension((VlHog *)vl));
 
-	std::vector<float> hog_array(hog_width * hog_height * dimensions);
-	vl_hog_extract((VlHog *)_hog, hog_array.data());
-	hog_glyph_size = vl_hog_get_glyph_size((VlHog *)_hog);
+	const auto size = hog_width * hog_height * dimensions();
+	scratch::buffer hog_array(size);
+	vl_hog_extract((VlHog *)vl, hog_array.data());
+	hog_glyph_size = vl_hog_get_glyph_size((VlHog *)vl);
 
-	hog_converted_data = vlarray_to_cvstylevec(hog_array, hog_height, hog_width, dimensions);
-	hog_converted = cv::Mat((int)hog_height, (int)hog_width, CV_32FC(int(dimensions)), hog_converted_data.data());
+	hog_converted_data = scratch::take(size);
+	kernels::interleave(hog_array.data(), hog_converted_data.data(), hog_height * hog_width, dimensions());
+	hog_converted = cv::Mat((int)hog_height, (int)hog_width, CV_32FC(int(dimensions())), hog_converted_data.data());
 }
 
 hog::~hog()
 {
-	vl_hog_delete((VlHog *)_hog);
+	scratch::recycle(std::move(hog_converted_data));
 }
 
 cv::Mat hog::render() const
@@ -49,31 +224,38 @@ cv::Mat hog::render() const
 
 cv::Mat hog::render(const cv::Mat& mat) const
 {
-	assert(mat.type() == CV_32FC(int(dimensions)));
-	std::vector<float> hog_array = cvmat_to_vlarray<float>(mat);
-	std::vector<float> img(mat.cols * hog_glyph_size * mat.rows * hog_glyph_size);
-	vl_hog_render((VlHog *)_hog, img.data(), hog_array.data(), mat.cols, mat.rows);
+	assert(mat.type() == CV_32FC(int(dimensions())));
+	scratch::buffer hog_array(mat.channels() * mat.rows * mat.cols);
+	cvmat_to_vlarray<float>(mat, hog_array.data());
+	scratch::buffer img(mat.cols * hog_glyph_size * mat.rows * hog_glyph_size);
+	// any vl_hog of the geometry renders
+	vl_hog_render((VlHog *)scratch::extractor(0, 0), img.data(), hog_array.data(), mat.cols, mat.rows);
 	auto image = cv::Mat(int(hog_glyph_size * mat.rows), int(hog_glyph_size * mat.cols), CV_32FC1, img.data());
 	return image.clone();
 }
 
 const cv::Mat hog::operator()(const cv::Rect& roi) const
 {
-	const int x = roi.x / cellsize;
-	const int y = roi.y / cellsize;
-	const int width = (roi.width + cellsize / 2) / cellsize;
-	const int height = (roi.height + cellsize / 2) / cellsize;
+	return hog_converted(cell_rect(roi));
+}
+
+cv::Rect hog::cell_rect(const cv::Rect& roi)
+{
+	const int x = roi.x / cellsize();
+	const int y = roi.y / cellsize();
+	const int width = (roi.width + cellsize() / 2) / cellsize();
+	const int height = (roi.height + cellsize() / 2) / cellsize();
 	// assuming we have a 2x2 hog and cellsize=8, we'd get a 0x0 mat
 	// if we have a x = y = 0, width = height = 3
 	// its not possible to create a hog of a 3x3 image however
 	// (this ensures that we always have at least a 1x1 hog)
-	return hog_converted(cv::Rect(x, y, std::max(1, width), std::max(1, height)));
+	return cv::Rect(x, y, std::max(1, width), std::max(1, height));
 }
 
 std::size_t hog::hog_size(const cv::Rect& roi)
 {
-	const int height = (roi.height + cellsize / 2) / cellsize;
-	const int width = (roi.width + cellsize / 2) / cellsize;
+	const int height = (roi.height + cellsize() / 2) / cellsize();
+	const int width = (roi.width + cellsize() / 2) / cellsize();
 
-	return dimensions * height * width;
+	return dimensions() * height * width;
 }
\ No newline at end of file
@@ -2,35 +2,41 @@
 
 #include <opencv2/core/core.hpp>	// Mat, Rect
 #include <vector>
+#include "geometry.h"
 
 namespace mmp
 {
 	class hog
 	{
 	public:
-		enum hog_variant
-		{
-			DalalTriggs,
-			UoCCTi
-		};
-
-		static const hog_variant variant = UoCCTi;
-		static const unsigned cellsize = 8;
-		static const unsigned orientations = 9;
-		static const unsigned dimensions = (variant == UoCCTi) ? (4 + 3 * orientations) : (4 * orientations);
+		// of the active geometry
+		static geometry::hog_variant variant()	{ return geometry::active().variant; }
+		static unsigned cellsize()				{ return geometry::active().cellsize; }
+		static unsigned orientations()			{ return geometry::active().orientations; }
+		static unsigned dimensions()			{ return geometry::active().dimensions(); }
 
 		typedef std::vector<float> array_type;		
-		typedef cv::Vec<float, dimensions> vector_type;
+
+		// gradient modulus and directed orientation (CV_32FC1) as vl_hog_put_image computes them,
+		// hogs of several (shifted) grids can be extracted from it without recomputing the gradients
+		struct gradient_field
+		{
+			cv::Mat modulus;
+			cv::Mat angle;
+		};
 
 	private:
-		void * _hog;					// vl_hog
-		array_type hog_converted_data;	// hogarray converted to cv-order
+		array_type hog_converted_data;	// hogarray converted to cv-order (recycled by the scratch pool)
 		cv::Mat hog_converted;	// cv::Mat view on this converted array
 
 		array_type::size_type hog_width;
 		array_type::size_type hog_height;
 		array_type::size_type hog_glyph_size;
 
+	private:
+		// vl is the (scratch) vl_hog the image was put into
+		void extract(void * vl);
+
 	public:
 		//
 		// 111 222 333    123 123 123
@@ -47,10 +53,17 @@ namespace mmp
 		template<class T>
 		static array_type cvmat_to_vlarray(const cv::Mat& mat)	// convert a float cv::Mat to float vlarray
 		{
-			const int channels = mat.channels();
+			std::vector<float> vlarray(mat.channels() * mat.rows * mat.cols);
+			cvmat_to_vlarray<T>(mat, vlarray.data());
+			return vlarray;
+		}
 
-			std::vector<float> vlarray(channels * mat.rows * mat.cols);
-			auto dataptr = vlarray.data();
+		// as above into vlarray (channels * rows * cols values)
+		template<class T>
+		static void cvmat_to_vlarray(const cv::Mat& mat, float * vlarray)
+		{
+			const int channels = mat.channels();
+			auto dataptr = vlarray;
 
 			for (int c = 0; c < channels; c++)
 			{
@@ -64,14 +77,32 @@ namespace mmp
 					}
 				}
 			}
-
-			return vlarray;
 		}
 
 	public:
 		static std::size_t hog_size(const cv::Rect& roi);
+		static gradient_field gradients(const cv::Mat& src);
+		// as above, the matrices of field are reused if they already have the size of src
+		static void gradients(const cv::Mat& src, gradient_field& field);
+		// the cells covered by roi (in pixels), as used by operator()
+		static cv::Rect cell_rect(const cv::Rect& roi);
+
+		// hogs of same-size crops (CV_8UC1 or CV_8UC3) as one CV_32FC1 matrix with one row per crop,
+		// the crops are processed in parallel and written in place (see descriptor for the hog mats)
+		static cv::Mat batch(const std::vector<cv::Mat>& crops);
+		// the hog mat (like operator()) of crop i of a batch, a view on its row
+		static cv::Mat descriptor(const cv::Mat& batch, int i, cv::Size crop_size);
+
+		// hog of the horizontally mirrored image: the cell columns are reversed and the dimensions
+		// permuted (mirrored orientations, the texture channels stay) as vl_hog_get_permutation defines it
+		static cv::Mat flip(const cv::Mat& features);
+		// largest difference between the flipped hogs of the crops and the hogs of the flipped crops
+		static float flip_error(const std::vector<cv::Mat>& crops);
 
-		hog(const cv::Mat& src);
+		// hog of the roi of an image (given by its gradient field)
+		hog(const gradient_field& field, const cv::Rect& roi);
+		// hog of already extracted features (in cv order, cells.area() * dimensions values)
+		hog(array_type&& features, cv::Size cells);
 		~hog();
 
 		const cv::Mat operator()() const { return hog_converted; }
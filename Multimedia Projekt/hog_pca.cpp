@@ -0,0 +1,91 @@
+#include "hog_pca.h"
+#include <cassert>
+using namespace mmp;
+
+hog_pca::hog_pca()
+	: dims(0), second_moment(hog::dimensions() * hog::dimensions(), 0), num_cells(0)
+{
+
+}
+
+void hog_pca::add(const float * cell)
+{
+	const unsigned cell_dims = hog::dimensions();
+	for (unsigned i = 0; i < cell_dims; i++)
+	{
+		for (unsigned j = i; j < cell_dims; j++)
+			second_moment[i * cell_dims + j] += double(cell[i]) * cell[j];
+	}
+
+	num_cells++;
+}
+
+void hog_pca::learn(unsigned dimensions)
+{
+	assert(num_cells && dimensions && dimensions <= hog::dimensions());
+
+	// hog cells are not centered (like felzenszwalb's cascade), so this is the
+	// eigen decomposition of the second moment and not of the covariance
+	cv::Mat moment((int)hog::dimensions(), (int)hog::dimensions(), CV_64FC1);
+	for (unsigned i = 0; i < hog::dimensions(); i++)
+	{
+		for (unsigned j = i; j < hog::dimensions(); j++)
+			moment.at<double>(i, j) = moment.at<double>(j, i) = second_moment[i * hog::dimensions() + j] / num_cells;
+	}
+
+	cv::Mat eigenvalues, eigenvectors;
+	cv::eigen(moment, eigenvalues, eigenvectors);
+
+	// eigenvectors are sorted by descending eigenvalues
+	dims = dimensions;
+	basis.resize(dims * hog::dimensions());
+	for (unsigned i = 0; i < dims; i++)
+	{
+		for (unsigned c = 0; c < hog::dimensions(); c++)
+			basis[i * hog::dimensions() + c] = float(eigenvectors.at<double>(i, c));
+	}
+}
+
+cv::Mat hog_pca::operator()(const cv::Mat& features) const
+{
+	assert(features.channels() == hog::dimensions());
+	cv::Mat projected(features.rows, features.cols, CV_32FC(int(dims)));
+
+	for (int y = 0; y < features.rows; y++)
+	{
+		const float * cell = features.ptr<float>(y);
+		float * out = projected.ptr<float>(y);
+		for (int x = 0; x < features.cols; x++)
+		{
+			project(cell, out);
+			cell += hog::dimensions();
+			out += dims;
+		}
+	}
+
+	return projected;
+}
+
+void hog_pca::save(std::ostream& out) const
+{
+	out << dims << std::endl;
+	for (unsigned i = 0; i < dims; i++)
+	{
+		for (unsigned c = 0; c < hog::dimensions(); c++)
+			out << basis[i * hog::dimensions() + c] << " ";
+		out << std::endl;
+	}
+}
+
+bool hog_pca::load(std::istream& in)
+{
+	in >> dims;
+	if (in.fail() || dims > hog::dimensions())
+		return false;
+
+	basis.resize(dims * hog::dimensions());
+	for (auto& b : basis)
+		in >> b;
+
+	return !in.fail();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <opencv2/core/core.hpp>	// Mat
+#include <vector>
+#include <istream>
+#include <ostream>
+#include "hog.h"
+
+namespace mmp
+{
+	// projects hog cells onto the principal components of the training cells (PCA-HOG)
+	class hog_pca
+	{
+	public:
+		typedef std::vector<float> array_type;
+
+	private:
+		unsigned dims;
+		array_type basis;					// dims x hog::dimensions (row major)
+		std::vector<double> second_moment;	// hog::dimensions x hog::dimensions
+		unsigned long num_cells;
+
+	public:
+		hog_pca();
+
+		// collect the statistics of a (hog::dimensions) cell and compute the basis with learn
+		void add(const float * cell);
+		void learn(unsigned dimensions);
+
+		unsigned dimensions() const { return dims; }
+		bool empty() const { return basis.empty(); }
+
+		// project a single cell (hog::dimensions values) to dimensions() values
+		template<class T, class U>
+		void project(const T * cell, U * projected) const
+		{
+			const float * b = basis.data();
+			const unsigned cell_dims = hog::dimensions();
+			for (unsigned i = 0; i < dims; i++)
+			{
+				U sum = 0;
+				for (unsigned c = 0; c < cell_dims; c++)
+					sum += U(*b++ * cell[c]);
+
+				projected[i] = sum;
+			}
+		}
+
+		// project every cell of a mat returned by mmp::hog
+		cv::Mat operator()(const cv::Mat& features) const;
+
+		void save(std::ostream& out) const;
+		bool load(std::istream& in);
+	};
+}
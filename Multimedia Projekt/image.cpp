@@ -1,57 +1,145 @@
 #include "image.h"
 #include "helpers.h"
 #include "hog.h"
-#include "scale_cache.h"
+#include "pyramid.h"
 #include "classifier.h"
-#include <opencv2/imgproc/imgproc.hpp>	// resize
-#include <algorithm>					// sort, remove_if
+#include "kernels.h"
+#include "quantized_template.h"
+#include <algorithm>					// sort, remove_if, min, max
+#include <limits>						// numeric_limits
 #include <boost/bind.hpp>
 using namespace mmp;
 
-sliding_window::sliding_window(std::shared_ptr<const hog> h, int x, int y, float scale)
-	: _hog(h), _scale(scale), x(x), y(y)
+namespace
+{
+	// set once before any level is built
+	bool quantize_built_levels = false;
+}
+
+sliding_window::sliding_window(std::shared_ptr<const hog> h, int x, int y, float scale, cv::Point offset)
+	: _hog(h), _scale(scale), x(x), y(y), offset(offset)
 {
 
 }
 
 cv::Mat sliding_window::features() const
 {
-	return (*_hog)(cv::Rect(x, y, width, height));
+	return (*_hog)(cv::Rect(x, y, width(), height()));
+}
+
+cv::Rect sliding_window::cells() const
+{
+	return hog::cell_rect(cv::Rect(x, y, width(), height()));
 }
 
 cv::Rect sliding_window::rect() const
 {
-	return cv::Rect(int(x * _scale), int(y * _scale), int(width * _scale), int(height * _scale));
+	return cv::Rect(int((offset.x + x) * _scale), int((offset.y + y) * _scale), int(width() * _scale), int(height() * _scale));
+}
+
+scaled_image::scaled_image(const hog::gradient_field& field, cv::Point offset, float scale)
+	: scale(scale), offset(offset), size(field.modulus.cols - offset.x, field.modulus.rows - offset.y),
+	_hog(std::make_shared<hog>(field, cv::Rect(offset, size))), quantized_scale(1)
+{
+	place_windows();
+	quantize();
+}
+
+scaled_image::scaled_image(std::shared_ptr<hog> h, cv::Size size, cv::Point offset, float scale)
+	: scale(scale), offset(offset), size(size), _hog(h), quantized_scale(1)
+{
+	place_windows();
+	quantize();
+}
+
+void scaled_image::quantize()
+{
+	if (quantize_built_levels)
+		quantized = quantized_template::quantize((*_hog)(), quantized_scale);
+}
+
+void scaled_image::quantize_levels(bool enable)
+{
+	quantize_built_levels = enable;
 }
 
-scaled_image::scaled_image(cv::Mat src, float scale)
-	: scale(scale), _hog(std::make_shared<hog>(src))
+bool scaled_image::quantized_levels()
+{
+	return quantize_built_levels;
+}
+
+void scaled_image::place_windows()
 {
 	// sliding windows for current scale
-	for (int y = 0; y <= src.rows - sliding_window::height; y += hog::cellsize)
+	const int cellsize = hog::cellsize();
+	grid = cv::Size((size.width - sliding_window::width()) / cellsize + 1, (size.height - sliding_window::height()) / cellsize + 1);
+	windows.reserve(grid.area());
+	for (int y = 0; y <= size.height - sliding_window::height(); y += hog::cellsize())
 	{
-		for (int x = 0; x <= src.cols - sliding_window::width; x += hog::cellsize)
-			windows.emplace_back(std::const_pointer_cast<const hog>(_hog), x, y, scale);
+		for (int x = 0; x <= size.width - sliding_window::width(); x += hog::cellsize())
+			windows.emplace_back(std::const_pointer_cast<const hog>(_hog), x, y, scale, offset);
 	}
 }
 
-image::image(cv::Mat src)
+image::image(cv::Mat src, unsigned cell_subdivisions)
 {
-	static scale_cache scales(scales_per_octave);
+	// all grids of a level share the gradients of the level
+	auto pyramid = gradient_pyramid::acquire();
+	pyramid->build(src, cv::Size(sliding_window::width(), sliding_window::height()), scales_per_octave());
 
-	cv::Mat work = src;
-	float scale = 1;
-	for (unsigned i = 1; work.rows >= sliding_window::height && work.cols >= sliding_window::width; i++)
+	const int step = hog::cellsize() / std::max(1u, std::min(cell_subdivisions, hog::cellsize()));
+	std::vector<std::pair<std::size_t, cv::Point>> grids;	// level, offset
+	const auto& plan = pyramid->get_plan();
+	for (std::size_t i = 0; i < pyramid->size(); i++)
+	{
+		// the shifted grids that still fit a window
+		for (int dy = 0; dy < int(hog::cellsize()); dy += step)
+		{
+			for (int dx = 0; dx < int(hog::cellsize()); dx += step)
+			{
+				if (plan.window_grid(i, cv::Point(dx, dy)).area())
+					grids.push_back(std::make_pair(i, cv::Point(dx, dy)));
+			}
+		}
+	}
+
+	std::vector<std::unique_ptr<scaled_image>> built(grids.size());
+#pragma omp parallel for schedule(dynamic)
+	for (long i = 0; i < long(grids.size()); i++)
+	{
+		const auto& level = (*pyramid)[grids[i].first];
+		built[i].reset(new scaled_image(level.gradients, grids[i].second, level.scale));
+	}
+
+	gradient_pyramid::release(std::move(pyramid));
+
+	images.reserve(built.size());
+	for (auto& s : built)
+		images.push_back(std::move(*s));
+}
+
+std::size_t image::window_count(cv::Size size, unsigned cell_subdivisions)
+{
+	// the grids of image(img, cell_subdivisions)
+	const auto plan = pyramid_plan::get(size, scales_per_octave(), cv::Size(sliding_window::width(), sliding_window::height()));
+	const int step = hog::cellsize() / std::max(1u, std::min(cell_subdivisions, hog::cellsize()));
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < plan->levels().size(); i++)
 	{
-		images.emplace_back(scaled_image(work, scale));
-
-		scale = scales[i];
-		auto mod = i % scales_per_octave;
-		if (mod == 0)
-			cv::resize(src, src, cv::Size(src.cols / 2.0f, src.rows / 2.0f));
-		
-		cv::resize(src, work, cv::Size(src.cols / scales[mod], src.rows / scales[mod]));
+		for (int dy = 0; dy < int(hog::cellsize()); dy += step)
+		{
+			for (int dx = 0; dx < int(hog::cellsize()); dx += step)
+				count += plan->window_grid(i, cv::Point(dx, dy)).area();
+		}
 	}
+
+	return count;
+}
+
+image::image(std::vector<scaled_image>&& grids)
+	: images(std::move(grids))
+{
+
 }
 
 void image::add_detection(detection det/*, float max_overlap*/)
@@ -80,16 +168,23 @@ void image::suppress_non_maximum(float min_overlap)
 {
 	std::sort(detections.begin(), detections.end(), boost::bind(&detection::first, _1) > boost::bind(&detection::first, _2));
 	
-	for (auto i = detections.begin(); i != detections.end(); ++i)
+	// the overlaps of a detection with all weaker ones are computed at once
+	std::vector<cv::Rect> rects;
+	rects.reserve(detections.size());
+	for (auto& d : detections)
+		rects.push_back(d.second->rect());
+
+	std::vector<float> overlaps(detections.size());
+	for (std::size_t i = 0; i < detections.size(); i++)
 	{
-		if (i->first == 0) continue;
+		if (detections[i].first == 0) continue;
 
-		for (auto j = i + 1; j != detections.end(); ++j)
+		const auto weaker = int(detections.size() - i - 1);
+		kernels::overlaps(rects[i], rects.data() + i + 1, weaker, overlaps.data());
+		for (int j = 0; j < weaker; j++)
 		{
-			if (j->first == 0) continue;
-
-			if (get_overlap(i->second->rect(), j->second->rect()) >= min_overlap)
-				j->first = 0; // mark entry for deletion
+			if (overlaps[j] >= min_overlap)
+				detections[i + 1 + j].first = 0; // mark entry for deletion
 		}
 	}
 
@@ -101,15 +196,81 @@ void image::suppress_non_maximum(float min_overlap)
 	detections.erase(std::remove_if(detections.begin(), detections.end(), marked_for_deletion), detections.end());
 }
 
-void image::detect_all(const classifier& c, double threshold/*, float max_overlap*/)
+void image::detect_all(const classifier& c, double threshold/*, float max_overlap*/, unsigned coarse_stride, double coarse_margin)
 {
 	for (auto& s : scaled_images())
 	{
+		// either all windows of the level are scored at once or
+		// the projected level is the first pass if the classifier has a pca basis
+		cv::Mat scores = c.score_map(s), projected;
+		if (scores.empty() && c.has_pca() && threshold != -std::numeric_limits<double>::infinity())
+			projected = c.project((*s.get_hog())());
+
+		auto score = [&](const sliding_window& sw, double min_score)
+		{
+			if (!scores.empty())
+			{
+				const auto cells = sw.cells();
+				return scores.at<double>(cells.y, cells.x);
+			}
+
+			if (!projected.empty() && c.classify_projected(projected(sw.cells())) <= min_score)
+				return -std::numeric_limits<double>::infinity();
+
+			return c.classify(sw.features(), min_score);
+		};
+
+		if (coarse_stride > 1)
+		{
+			detect_coarse_to_fine(s, score, threshold, coarse_stride, coarse_margin);
+			continue;
+		}
+
 		for (auto& sw : s.sliding_windows())
 		{
-			double a = c.classify(sw.features());
+			double a = score(sw, threshold);
 			if (a > threshold)
 				add_detection(std::make_pair(a, &sw)/*, max_overlap*/);
 		}
 	}
+}
+
+void image::detect_coarse_to_fine(const scaled_image& s, const window_scorer& score_window, double threshold, unsigned stride, double margin)
+{
+	const auto& windows = s.sliding_windows();
+	const auto grid = s.window_grid();
+	const int radius = int(stride) - 1;
+	std::vector<bool> scored(windows.size(), false);
+
+	auto score = [&](int x, int y, double min_score)
+	{
+		const auto i = y * grid.width + x;
+		scored[i] = true;
+
+		double a = score_window(windows[i], min_score);
+		if (a > threshold)
+			add_detection(std::make_pair(a, &windows[i]));
+
+		return a;
+	};
+
+	// the score surface is smooth, so a window scoring close to the threshold
+	// is a hint that one of its neighbours lies above the threshold
+	for (int y = 0; y < grid.height; y += stride)
+	{
+		for (int x = 0; x < grid.width; x += stride)
+		{
+			if (score(x, y, threshold - margin) <= threshold - margin)
+				continue;
+
+			for (int ny = std::max(0, y - radius); ny <= std::min(grid.height - 1, y + radius); ny++)
+			{
+				for (int nx = std::max(0, x - radius); nx <= std::min(grid.width - 1, x + radius); nx++)
+				{
+					if (!scored[ny * grid.width + nx])
+						score(nx, ny, threshold);
+				}
+			}
+		}
+	}
 }
\ No newline at end of file
@@ -3,26 +3,32 @@
 #include <vector>
 #include <utility>		// pair
 #include <memory>		// shared_ptr, const_pointer_cast
+#include <functional>	// function
 #include "hog.h"
+#include "geometry.h"
 
 namespace mmp
 {
 	class sliding_window
 	{
 	public:
-		static const int width = 64;
-		static const int height = 128;
+		// of the active geometry
+		static int width()	{ return geometry::active().window_width; }
+		static int height()	{ return geometry::active().window_height; }
 
 	private:
 		std::shared_ptr<const hog> _hog;
 		float _scale;
 		int x;
 		int y;
+		cv::Point offset;	// of the hog grid in the scaled image
 
 	public:
-		sliding_window(std::shared_ptr<const hog> _hog, int x, int y, float scale);
+		sliding_window(std::shared_ptr<const hog> _hog, int x, int y, float scale, cv::Point offset = cv::Point());
 
 		cv::Mat features() const;
+		// the hog cells of this window (in the hog of its scaled_image)
+		cv::Rect cells() const;
 		cv::Rect rect() const;
 		float scale() const		{ return _scale; }
 	};
@@ -31,22 +37,44 @@ namespace mmp
 	{
 	private:
 		float scale;
+		cv::Point offset;	// of the hog grid in the scaled image
+		cv::Size size;		// covered by the hog grid (in pixels)
+		cv::Size grid;		// number of windows in x and y direction
 		std::vector<sliding_window> windows;
 		std::shared_ptr<hog> _hog;
+		cv::Mat quantized;		// uint8 copy of the hog (see quantize_levels), empty if not quantized
+		double quantized_scale;
+
+		void place_windows();
+		void quantize();
 
 	public:
-		scaled_image(cv::Mat src, float scale);
+		// hog grid starting at offset (in pixels) of the scaled image given by its gradient field
+		scaled_image(const hog::gradient_field& field, cv::Point offset, float scale);
+		// grid of an already computed hog covering size pixels (e.g. from the feature cache)
+		scaled_image(std::shared_ptr<hog> h, cv::Size size, cv::Point offset, float scale);
 
+		// windows are stored row by row
 		const std::vector<sliding_window>& sliding_windows() const { return windows; }
+		cv::Size window_grid() const { return grid; }
 		float get_scale() const { return scale; }
+		cv::Point get_offset() const { return offset; }
+		cv::Size get_size() const { return size; }
 		std::shared_ptr<const hog> get_hog() const { return std::const_pointer_cast<const hog>(_hog); }
+		// the hog quantized by quantized_template::quantize and its scale (empty if levels aren't quantized)
+		const cv::Mat& get_quantized() const { return quantized; }
+		double get_quantized_scale() const { return quantized_scale; }
+
+		// levels built from now on are quantized once (for classifiers scoring quantized levels), off by default
+		static void quantize_levels(bool enable);
+		static bool quantized_levels();
 	};
 
 	class classifier;
 	class image
 	{
 	public:
-		static const unsigned scales_per_octave = 5;
+		static unsigned scales_per_octave() { return geometry::active().scales_per_octave; }
 		typedef std::pair<double, const sliding_window *> detection;
 
 	private:
@@ -55,12 +83,24 @@ namespace mmp
 
 	private:
 		void add_detection(detection det/*, float max_overlap*/);
+		// scores a window, windows which can not exceed the given minimum score may be rejected (-infinity)
+		typedef std::function<double(const sliding_window& sw, double min_score)> window_scorer;
+		void detect_coarse_to_fine(const scaled_image& s, const window_scorer& score, double detection_threshold, unsigned coarse_stride, double coarse_margin);
 
 	public:
-		image(cv::Mat img);
+		// with cell_subdivisions > 1 additional hog grids shifted by cellsize / cell_subdivisions pixels
+		// are computed for every level, so the windows are placed at sub-cell steps
+		image(cv::Mat img, unsigned cell_subdivisions = 1);
+		// image of already built grids (e.g. from the feature cache)
+		explicit image(std::vector<scaled_image>&& grids);
+
+		// number of windows image(img, cell_subdivisions) places in an image of the given size
+		static std::size_t window_count(cv::Size size, unsigned cell_subdivisions = 1);
 
 		const std::vector<detection>& get_detections() const { return detections; }
-		void detect_all(const classifier& c, double detection_threshold = 0/*, float max_overlap = 0.2f*/);
+		// coarse_stride > 1 enables the coarse-to-fine search: only every coarse_stride-th window (in x and y) is scored first,
+		// the neighbourhood of windows scoring above detection_threshold - coarse_margin is then scored densely
+		void detect_all(const classifier& c, double detection_threshold = 0/*, float max_overlap = 0.2f*/, unsigned coarse_stride = 1, double coarse_margin = 1);
 		void suppress_non_maximum(float min_overlap = 0.2f);		
 
 		const std::vector<scaled_image>& scaled_images() const { return images; }
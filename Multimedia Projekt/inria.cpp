@@ -2,12 +2,13 @@
 using namespace mmp;
 
 inria_cfg::inria_cfg()
+	: cascade(false), _coarse_stride(1), _coarse_margin(1), pca(false), _pca_dimensions(12), _low_rank(0), fft(false), quantized(false), compact(false), subdivisions(1), mirror_pos(false), mirror_hard(false), _io_threads(2), _prefetch_depth(32), archives(false), _feature_cache_size(0), resume(false), folds(5), _cv_fppw(1e-4)
 {
 
 }
 
 inria_cfg::inria_cfg(const std::string& r, const std::string& s, const std::string& sh, const std::string& ev, const std::string& evh, double c, unsigned num_rng_windows_per_neg_sample, unsigned num_false_positives_training)
-	: root(r), svm_path_normal(s), svm_path_hard(sh), eval_file(ev), eval_file_hard(evh), _svm_c(c), num_rngs(num_rng_windows_per_neg_sample), num_fps(num_false_positives_training)
+	: root(r), svm_path_normal(s), svm_path_hard(sh), eval_file(ev), eval_file_hard(evh), _svm_c(c), num_rngs(num_rng_windows_per_neg_sample), num_fps(num_false_positives_training), cascade(false), _coarse_stride(1), _coarse_margin(1), pca(false), _pca_dimensions(12), _low_rank(0), fft(false), quantized(false), compact(false), subdivisions(1), mirror_pos(false), mirror_hard(false), _io_threads(2), _prefetch_depth(32), archives(false), _feature_cache_size(0), resume(false), folds(5), _cv_fppw(1e-4)
 {
 
 }
@@ -31,6 +32,41 @@ unsigned inria_cfg::normalized_positive_test_y_offset() const { return 3; }
 unsigned inria_cfg::normalized_positive_test_x_offset() const { return 3; }
 unsigned inria_cfg::random_windows_per_negative_training_sample() const { return num_rngs; }
 double inria_cfg::svm_c() const { return _svm_c; }
+bool inria_cfg::use_cascade() const { return cascade; }
+void inria_cfg::set_cascade(bool enable) { cascade = enable; }
+unsigned inria_cfg::coarse_stride() const { return _coarse_stride; }
+double inria_cfg::coarse_margin() const { return _coarse_margin; }
+void inria_cfg::set_coarse_to_fine(unsigned stride, double margin) { _coarse_stride = stride; _coarse_margin = margin; }
+bool inria_cfg::use_pca() const { return pca; }
+unsigned inria_cfg::pca_dimensions() const { return _pca_dimensions; }
+void inria_cfg::set_pca(bool enable, unsigned dimensions) { pca = enable; _pca_dimensions = dimensions; }
+unsigned inria_cfg::low_rank() const { return _low_rank; }
+void inria_cfg::set_low_rank(unsigned rank) { _low_rank = rank; }
+bool inria_cfg::use_fft() const { return fft; }
+void inria_cfg::set_fft(bool enable) { fft = enable; }
+bool inria_cfg::use_quantized() const { return quantized; }
+void inria_cfg::set_quantized(bool enable) { quantized = enable; }
+bool inria_cfg::compact_features() const { return compact; }
+void inria_cfg::set_compact_features(bool enable) { compact = enable; }
+unsigned inria_cfg::cell_subdivisions() const { return subdivisions; }
+void inria_cfg::set_cell_subdivisions(unsigned n) { subdivisions = n; }
+bool inria_cfg::mirror_positives() const { return mirror_pos; }
+bool inria_cfg::mirror_hard_negatives() const { return mirror_hard; }
+void inria_cfg::set_mirroring(bool positives, bool hard_negatives) { mirror_pos = positives; mirror_hard = hard_negatives; }
+unsigned inria_cfg::io_threads() const { return _io_threads; }
+unsigned inria_cfg::prefetch_depth() const { return _prefetch_depth; }
+void inria_cfg::set_prefetch(unsigned threads, unsigned depth) { _io_threads = threads; _prefetch_depth = depth; }
+bool inria_cfg::use_archives() const { return archives; }
+void inria_cfg::set_archives(bool enable) { archives = enable; }
+unsigned inria_cfg::feature_cache_size() const { return _feature_cache_size; }
+void inria_cfg::set_feature_cache_size(unsigned megabytes) { _feature_cache_size = megabytes; }
+std::string inria_cfg::feature_cache_file() const { return root + "/feature_cache.dat"; }
+bool inria_cfg::resume_training() const { return resume; }
+void inria_cfg::set_resume_training(bool enable) { resume = enable; }
+const std::vector<double>& inria_cfg::svm_c_grid() const { return c_grid; }
+unsigned inria_cfg::cv_folds() const { return folds; }
+double inria_cfg::cv_fppw() const { return _cv_fppw; }
+void inria_cfg::set_model_selection(const std::vector<double>& grid, unsigned k, double fppw) { c_grid = grid; folds = k; _cv_fppw = fppw; }
 std::string inria_cfg::training_file() const { return root + "/training_normal.dat"; }
 std::string inria_cfg::training_hard_file() const { return root + "/training_hard.dat"; }
 unsigned inria_cfg::num_hard_false_positive_retrain() const { return num_fps; }
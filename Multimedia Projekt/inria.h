@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 
 namespace mmp
 {
@@ -14,6 +15,26 @@ namespace mmp
 		double _svm_c;
 		unsigned num_rngs;
 		unsigned num_fps;
+		bool cascade;
+		unsigned _coarse_stride;
+		double _coarse_margin;
+		bool pca;
+		unsigned _pca_dimensions;
+		unsigned _low_rank;
+		bool fft;
+		bool quantized;
+		bool compact;
+		unsigned subdivisions;
+		bool mirror_pos;
+		bool mirror_hard;
+		unsigned _io_threads;
+		unsigned _prefetch_depth;
+		bool archives;
+		unsigned _feature_cache_size;
+		bool resume;
+		std::vector<double> c_grid;
+		unsigned folds;
+		double _cv_fppw;
 
 	public:
 		inria_cfg();
@@ -47,6 +68,42 @@ namespace mmp
 		std::string negative_test_path() const;
 
 		double svm_c() const;
+		bool use_cascade() const;
+		void set_cascade(bool enable);
+		unsigned coarse_stride() const;
+		double coarse_margin() const;
+		void set_coarse_to_fine(unsigned stride, double margin);
+		bool use_pca() const;
+		unsigned pca_dimensions() const;
+		void set_pca(bool enable, unsigned dimensions);
+		unsigned low_rank() const;
+		void set_low_rank(unsigned rank);
+		bool use_fft() const;
+		void set_fft(bool enable);
+		bool use_quantized() const;
+		void set_quantized(bool enable);
+		bool compact_features() const;
+		void set_compact_features(bool enable);
+		unsigned cell_subdivisions() const;
+		void set_cell_subdivisions(unsigned n);
+		bool mirror_positives() const;
+		bool mirror_hard_negatives() const;
+		void set_mirroring(bool positives, bool hard_negatives);
+		unsigned io_threads() const;
+		unsigned prefetch_depth() const;
+		void set_prefetch(unsigned threads, unsigned depth);
+		bool use_archives() const;
+		void set_archives(bool enable);
+		unsigned feature_cache_size() const;
+		void set_feature_cache_size(unsigned megabytes);
+		std::string feature_cache_file() const;
+		bool resume_training() const;
+		void set_resume_training(bool enable);
+		// model selection: svm_c is chosen from the grid by k-fold cross validation (empty grid = off)
+		const std::vector<double>& svm_c_grid() const;
+		unsigned cv_folds() const;
+		double cv_fppw() const;
+		void set_model_selection(const std::vector<double>& grid, unsigned folds, double fppw);
 		std::string training_file() const;
 		std::string training_hard_file() const;
 	};
@@ -0,0 +1,574 @@
+#include "kernels.h"
+#include <algorithm>	// min, max
+#include <cassert>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MMP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>		// cpuid, xgetbv
+#endif
+#endif
+
+// gcc compiles single functions for an instruction set (the kernels are selected at runtime,
+// so the rest of the binary keeps the baseline), msvc emits any intrinsic without flags
+#ifdef __GNUC__
+#define MMP_TARGET(isa) __attribute__((target(isa)))
+#define MMP_INLINE inline __attribute__((always_inline))
+#else
+#define MMP_TARGET(isa)
+#define MMP_INLINE __forceinline
+#endif
+
+#if defined(MMP_X86) && (defined(__GNUC__) || _MSC_VER >= 1700)
+#define MMP_AVX2
+#endif
+
+#if defined(MMP_X86) && ((defined(__GNUC__) && __GNUC__ >= 5) || _MSC_VER >= 1911)
+#define MMP_AVX512
+#endif
+
+using namespace mmp;
+
+namespace
+{
+	//
+	// kernels without intrinsics, compiled once per instruction set (auto vectorized)
+	//
+	MMP_INLINE void interleave_body(const float * planes, float * cells, std::size_t plane_size, unsigned dims)
+	{
+		for (std::size_t i = 0; i < plane_size; i++)
+		{
+			for (unsigned c = 0; c < dims; c++)
+				cells[i * dims + c] = planes[c * plane_size + i];
+		}
+	}
+
+	MMP_INLINE void overlaps_body(const cv::Rect& rect, const cv::Rect * rects, int n, float * out)
+	{
+		const int area = rect.width * rect.height;
+		for (int i = 0; i < n; i++)
+		{
+			const int width = std::max(0, std::min(rect.x + rect.width, rects[i].x + rects[i].width) - std::max(rect.x, rects[i].x));
+			const int height = std::max(0, std::min(rect.y + rect.height, rects[i].y + rects[i].height) - std::max(rect.y, rects[i].y));
+			const int inter = width * height;
+			const int _union = area + rects[i].width * rects[i].height - inter;
+			out[i] = _union ? (float(inter) / _union) : 0;
+		}
+	}
+
+	//
+	// generic
+	//
+	double dot_generic(const double * a, const float * b, int n)
+	{
+		double sum = 0;
+		for (int i = 0; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	double dot_generic(const float * a, const float * b, int n)
+	{
+		double sum = 0;
+		for (int i = 0; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	int dot_generic(const uchar * a, const short * b, int n)
+	{
+		int sum = 0;
+		for (int i = 0; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	void interleave_generic(const float * planes, float * cells, std::size_t plane_size, unsigned dims)
+	{
+		interleave_body(planes, cells, plane_size, dims);
+	}
+
+	void overlaps_generic(const cv::Rect& rect, const cv::Rect * rects, int n, float * out)
+	{
+		overlaps_body(rect, rects, n, out);
+	}
+
+#ifdef MMP_X86
+	//
+	// sse2
+	//
+	MMP_TARGET("sse2") double dot_sse2(const double * a, const float * b, int n)
+	{
+		__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m128 f = _mm_loadu_ps(b + i);
+			acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_cvtps_pd(f)));
+			acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_cvtps_pd(_mm_movehl_ps(f, f))));
+		}
+
+		double partial[2];
+		_mm_storeu_pd(partial, _mm_add_pd(acc0, acc1));
+		double sum = partial[0] + partial[1];
+		for (; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	MMP_TARGET("sse2") double dot_sse2(const float * a, const float * b, int n)
+	{
+		__m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+		int i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+		}
+
+		float partial[4];
+		_mm_storeu_ps(partial, _mm_add_ps(acc0, acc1));
+		double sum = double(partial[0]) + partial[1] + partial[2] + partial[3];
+		for (; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	MMP_TARGET("sse2") int dot_sse2(const uchar * a, const short * b, int n)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i acc = _mm_setzero_si128();
+		int i = 0;
+		for (; i + 16 <= n; i += 16)
+		{
+			const __m128i features = _mm_loadu_si128((const __m128i *)(a + i));
+			const __m128i lo = _mm_unpacklo_epi8(features, zero);
+			const __m128i hi = _mm_unpackhi_epi8(features, zero);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(lo, _mm_loadu_si128((const __m128i *)(b + i))));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(hi, _mm_loadu_si128((const __m128i *)(b + i + 8))));
+		}
+
+		int partial[4];
+		_mm_storeu_si128((__m128i *)partial, acc);
+		int sum = partial[0] + partial[1] + partial[2] + partial[3];
+		for (; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	MMP_TARGET("sse2") void interleave_sse2(const float * planes, float * cells, std::size_t plane_size, unsigned dims)
+	{
+		interleave_body(planes, cells, plane_size, dims);
+	}
+
+	MMP_TARGET("sse2") void overlaps_sse2(const cv::Rect& rect, const cv::Rect * rects, int n, float * out)
+	{
+		overlaps_body(rect, rects, n, out);
+	}
+#endif
+
+#ifdef MMP_AVX2
+	//
+	// avx2
+	//
+	MMP_TARGET("avx2,fma") double dot_avx2(const double * a, const float * b, int n)
+	{
+		__m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+		int i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_cvtps_pd(_mm_loadu_ps(b + i)), acc0);
+			acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_cvtps_pd(_mm_loadu_ps(b + i + 4)), acc1);
+		}
+
+		double partial[4];
+		_mm256_storeu_pd(partial, _mm256_add_pd(acc0, acc1));
+		double sum = partial[0] + partial[1] + partial[2] + partial[3];
+		for (; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	MMP_TARGET("avx2,fma") double dot_avx2(const float * a, const float * b, int n)
+	{
+		__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+		int i = 0;
+		for (; i + 16 <= n; i += 16)
+		{
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+			acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+		}
+
+		float partial[8];
+		_mm256_storeu_ps(partial, _mm256_add_ps(acc0, acc1));
+		double sum = 0;
+		for (int j = 0; j < 8; j++)
+			sum += partial[j];
+
+		for (; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	MMP_TARGET("avx2,fma") int dot_avx2(const uchar * a, const short * b, int n)
+	{
+		__m256i acc = _mm256_setzero_si256();
+		int i = 0;
+		for (; i + 16 <= n; i += 16)
+		{
+			const __m256i features = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(a + i)));
+			acc = _mm256_add_epi32(acc, _mm256_madd_epi16(features, _mm256_loadu_si256((const __m256i *)(b + i))));
+		}
+
+		int partial[8];
+		_mm256_storeu_si256((__m256i *)partial, acc);
+		int sum = 0;
+		for (int j = 0; j < 8; j++)
+			sum += partial[j];
+
+		for (; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	MMP_TARGET("avx2,fma") void interleave_avx2(const float * planes, float * cells, std::size_t plane_size, unsigned dims)
+	{
+		interleave_body(planes, cells, plane_size, dims);
+	}
+
+	MMP_TARGET("avx2,fma") void overlaps_avx2(const cv::Rect& rect, const cv::Rect * rects, int n, float * out)
+	{
+		overlaps_body(rect, rects, n, out);
+	}
+#endif
+
+#ifdef MMP_AVX512
+	//
+	// avx512
+	//
+	MMP_TARGET("avx512f,avx512bw") double dot_avx512(const double * a, const float * b, int n)
+	{
+		__m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+		int i = 0;
+		for (; i + 16 <= n; i += 16)
+		{
+			acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_maskz_cvtps_pd(0xff, _mm256_loadu_ps(b + i)), acc0);
+			acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_maskz_cvtps_pd(0xff, _mm256_loadu_ps(b + i + 8)), acc1);
+		}
+
+		double partial[8];
+		_mm512_storeu_pd(partial, _mm512_add_pd(acc0, acc1));
+		double sum = 0;
+		for (int j = 0; j < 8; j++)
+			sum += partial[j];
+
+		for (; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	MMP_TARGET("avx512f,avx512bw") double dot_avx512(const float * a, const float * b, int n)
+	{
+		__m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+		int i = 0;
+		for (; i + 32 <= n; i += 32)
+		{
+			acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+			acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+		}
+
+		float partial[16];
+		_mm512_storeu_ps(partial, _mm512_add_ps(acc0, acc1));
+		double sum = 0;
+		for (int j = 0; j < 16; j++)
+			sum += partial[j];
+
+		for (; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	MMP_TARGET("avx512f,avx512bw") int dot_avx512(const uchar * a, const short * b, int n)
+	{
+		__m512i acc = _mm512_setzero_si512();
+		int i = 0;
+		for (; i + 32 <= n; i += 32)
+		{
+			const __m512i features = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(a + i)));
+			acc = _mm512_add_epi32(acc, _mm512_madd_epi16(features, _mm512_loadu_si512((const void *)(b + i))));
+		}
+
+		int partial[16];
+		_mm512_storeu_si512((void *)partial, acc);
+		int sum = 0;
+		for (int j = 0; j < 16; j++)
+			sum += partial[j];
+
+		for (; i < n; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	MMP_TARGET("avx512f,avx512bw") void interleave_avx512(const float * planes, float * cells, std::size_t plane_size, unsigned dims)
+	{
+		interleave_body(planes, cells, plane_size, dims);
+	}
+
+	MMP_TARGET("avx512f,avx512bw") void overlaps_avx512(const cv::Rect& rect, const cv::Rect * rects, int n, float * out)
+	{
+		overlaps_body(rect, rects, n, out);
+	}
+#endif
+
+	//
+	// dispatch
+	//
+	struct kernel_table
+	{
+		kernels::instruction_set isa;
+		double (*dot_df)(const double *, const float *, int);
+		double (*dot_ff)(const float *, const float *, int);
+		int (*dot_bs)(const uchar *, const short *, int);
+		void (*interleave)(const float *, float *, std::size_t, unsigned);
+		void (*overlaps)(const cv::Rect&, const cv::Rect *, int, float *);
+	};
+
+	kernel_table table_for(kernels::instruction_set isa)
+	{
+		switch (isa)
+		{
+#ifdef MMP_AVX512
+		case kernels::avx512:
+		{
+			kernel_table t = { isa, dot_avx512, dot_avx512, dot_avx512, interleave_avx512, overlaps_avx512 };
+			return t;
+		}
+#endif
+#ifdef MMP_AVX2
+		case kernels::avx2:
+		{
+			kernel_table t = { isa, dot_avx2, dot_avx2, dot_avx2, interleave_avx2, overlaps_avx2 };
+			return t;
+		}
+#endif
+#ifdef MMP_X86
+		case kernels::sse2:
+		{
+			kernel_table t = { isa, dot_sse2, dot_sse2, dot_sse2, interleave_sse2, overlaps_sse2 };
+			return t;
+		}
+#endif
+		default:
+		{
+			kernel_table t = { kernels::generic, dot_generic, dot_generic, dot_generic, interleave_generic, overlaps_generic };
+			return t;
+		}
+		}
+	}
+
+	kernels::instruction_set best_supported()
+	{
+		const kernels::instruction_set sets[] = { kernels::avx512, kernels::avx2, kernels::sse2 };
+		for (auto isa : sets)
+		{
+			if (kernels::supported(isa))
+				return isa;
+		}
+
+		return kernels::generic;
+	}
+
+	kernel_table active = table_for(best_supported());
+}
+
+const char * kernels::name(instruction_set isa)
+{
+	switch (isa)
+	{
+	case sse2: return "sse2";
+	case avx2: return "avx2";
+	case avx512: return "avx512";
+	default: return "generic";
+	}
+}
+
+bool kernels::supported(instruction_set isa)
+{
+	switch (isa)
+	{
+	case generic:
+		return true;
+
+#if defined(MMP_X86) && defined(__GNUC__)
+	case sse2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2") != 0;
+#ifdef MMP_AVX2
+	case avx2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#ifdef MMP_AVX512
+	case avx512:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+#elif defined(MMP_X86) && defined(_MSC_VER)
+	case sse2:
+	case avx2:
+	case avx512:
+	{
+		int info[4];
+		__cpuid(info, 0);
+		const int max_leaf = info[0];
+		__cpuid(info, 1);
+		const bool has_sse2 = (info[3] & (1 << 26)) != 0;
+		const bool has_fma = (info[2] & (1 << 12)) != 0;
+		// the os has to save the ymm (and zmm) registers
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		if (isa == sse2 || max_leaf < 7)
+			return has_sse2 && isa == sse2;
+
+		__cpuidex(info, 7, 0);
+		if (isa == avx2)
+			return has_fma && (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6;
+
+#ifdef MMP_AVX512
+		return (info[1] & (1 << 16)) && (info[1] & (1 << 30)) && (xcr0 & 0xe6) == 0xe6;
+#else
+		return false;
+#endif
+	}
+#endif
+
+	default:
+		return false;
+	}
+}
+
+kernels::instruction_set kernels::select(instruction_set isa)
+{
+	active = table_for(supported(isa) ? isa : best_supported());
+	return active.isa;
+}
+
+kernels::instruction_set kernels::selected()
+{
+	return active.isa;
+}
+
+double kernels::dot(const double * a, const float * b, int n)
+{
+	return active.dot_df(a, b, n);
+}
+
+double kernels::dot(const float * a, const float * b, int n)
+{
+	return active.dot_ff(a, b, n);
+}
+
+int kernels::dot(const uchar * a, const short * b, int n)
+{
+	return active.dot_bs(a, b, n);
+}
+
+void kernels::interleave(const float * planes, float * cells, std::size_t plane_size, unsigned dims)
+{
+	active.interleave(planes, cells, plane_size, dims);
+}
+
+void kernels::overlaps(const cv::Rect& rect, const cv::Rect * rects, int n, float * out)
+{
+	active.overlaps(rect, rects, n, out);
+}
+
+template<unsigned dims>
+double kernels::cell_dot(const double * weights, const float * features)
+{
+	double sum = 0;
+	for (unsigned c = 0; c < dims; c++)
+		sum += weights[c] * features[c];
+
+	return sum;
+}
+
+template<unsigned dims>
+double kernels::window_dot(const double * weights, const cv::Mat& features)
+{
+	assert(features.channels() == dims);
+
+	// same summation order as linear_model::classify, so the scores do not depend on the specialization
+	double sum = 0;
+	for (int y = 0; y < features.rows; y++)
+	{
+		const float * row = features.ptr<float>(y);
+		for (int x = 0; x < features.cols; x++, row += dims, weights += dims)
+		{
+			for (unsigned c = 0; c < dims; c++)
+				sum += weights[c] * row[c];
+		}
+	}
+
+	return sum;
+}
+
+template double kernels::cell_dot<31>(const double *, const float *);
+template double kernels::cell_dot<36>(const double *, const float *);
+template double kernels::window_dot<31>(const double *, const cv::Mat&);
+template double kernels::window_dot<36>(const double *, const cv::Mat&);
+
+double kernels::cell_dot(const double * weights, const float * features, unsigned dims)
+{
+	switch (dims)
+	{
+	case 31: return cell_dot<31>(weights, features);
+	case 36: return cell_dot<36>(weights, features);
+	default: return active.dot_df(weights, features, int(dims));
+	}
+}
+
+double kernels::window_dot(const double * weights, const cv::Mat& features)
+{
+	const int width = features.cols * features.channels();
+	if (active.isa != generic)
+	{
+		// the values of a row are contiguous
+		double sum = 0;
+		for (int y = 0; y < features.rows; y++, weights += width)
+			sum += active.dot_df(weights, features.ptr<float>(y), width);
+
+		return sum;
+	}
+
+	switch (features.channels())
+	{
+	case 31: return window_dot<31>(weights, features);
+	case 36: return window_dot<36>(weights, features);
+	default:
+	{
+		double sum = 0;
+		for (int y = 0; y < features.rows; y++, weights += width)
+		{
+			const float * row = features.ptr<float>(y);
+			for (int i = 0; i < width; i++)
+				sum += weights[i] * row[i];
+		}
+
+		return sum;
+	}
+	}
+}
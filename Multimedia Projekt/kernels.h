@@ -0,0 +1,59 @@
+#pragma once
+#include <opencv2/core/core.hpp>	// Mat, Rect
+#include <cstddef>					// size_t
+
+namespace mmp
+{
+	// inner loops of feature extraction and scoring. the vector kernels are compiled for several
+	// instruction sets and the best one supported by the cpu is used (see select).
+	// the cell kernels are specialized (and explicitly instantiated) for the dimensions of
+	// the common geometries: 31 (uoccti, 9 orientations) and 36 (dalaltriggs, 9 orientations)
+	namespace kernels
+	{
+		enum instruction_set
+		{
+			generic,
+			sse2,
+			avx2,	// with fma
+			avx512	// avx512f and avx512bw
+		};
+
+		const char * name(instruction_set isa);
+		// whether the cpu supports isa and this build contains kernels for it
+		bool supported(instruction_set isa);
+		// the best supported instruction set is selected at startup, select changes it
+		// (before any kernel runs) and returns the set actually used (isa if supported)
+		instruction_set select(instruction_set isa);
+		instruction_set selected();
+
+		//
+		// vector kernels (dispatched)
+		//
+		double dot(const double * a, const float * b, int n);
+		// the products are summed in float (per lane)
+		double dot(const float * a, const float * b, int n);
+		// the products are summed in 32 bit
+		int dot(const uchar * a, const short * b, int n);
+		// vl_hog's layout (one plane of plane_size values per dimension) to interleaved cells (dims values each)
+		void interleave(const float * planes, float * cells, std::size_t plane_size, unsigned dims);
+		// intersection over union of rect and each of the n rects (see mmp::get_overlap)
+		void overlaps(const cv::Rect& rect, const cv::Rect * rects, int n, float * out);
+
+		//
+		// cell kernels
+		//
+		// sum of weights[i] * features[i] over the values of one cell
+		template<unsigned dims>
+		double cell_dot(const double * weights, const float * features);
+
+		// sum of weights[i] * features[i] over all values of a hog mat (in the order of
+		// mmp::classifier::features_to_svector), equals the linear svm score without bias
+		template<unsigned dims>
+		double window_dot(const double * weights, const cv::Mat& features);
+
+		// the above for the dimensions of the given mat, any other dimensions fall back to a generic loop.
+		// with a vector instruction set window_dot sums each row with dot (so the rounding differs slightly)
+		double cell_dot(const double * weights, const float * features, unsigned dims);
+		double window_dot(const double * weights, const cv::Mat& features);
+	}
+}
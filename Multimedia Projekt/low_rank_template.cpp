@@ -0,0 +1,116 @@
+#include "low_rank_template.h"
+#include "hog.h"
+#include "kernels.h"
+#include <cmath>	// sqrt
+#include <cassert>
+#include <algorithm>	// min
+using namespace mmp;
+
+low_rank_template::low_rank_template()
+	: rows(0), cols(0), _rank(0)
+{
+
+}
+
+low_rank_template::low_rank_template(const double * weights, int rows, int cols, unsigned rank)
+	: rows(rows), cols(cols)
+{
+	// rows x (cols * dimensions) so the svd separates the vertical from the horizontal (and orientation) part
+	const int width = cols * int(hog::dimensions());
+	cv::Mat w(rows, width, CV_64FC1);
+	for (int y = 0; y < rows; y++)
+	{
+		for (int i = 0; i < width; i++)
+			w.at<double>(y, i) = weights[y * width + i];
+	}
+
+	cv::SVD svd(w);
+	singular_values.resize(svd.w.rows);
+	for (int i = 0; i < svd.w.rows; i++)
+		singular_values[i] = svd.w.at<double>(i);
+
+	_rank = std::min(rank, max_rank());
+	column_filters.resize(_rank * rows);
+	row_filters.resize(_rank * width);
+	for (unsigned r = 0; r < _rank; r++)
+	{
+		for (int y = 0; y < rows; y++)
+			column_filters[r * rows + y] = float(singular_values[r] * svd.u.at<double>(y, r));
+
+		for (int i = 0; i < width; i++)
+			row_filters[r * width + i] = float(svd.vt.at<double>(r, i));
+	}
+}
+
+double low_rank_template::residual(unsigned rank) const
+{
+	double total = 0, rest = 0;
+	for (unsigned i = 0; i < singular_values.size(); i++)
+	{
+		total += singular_values[i] * singular_values[i];
+		if (i >= rank)
+			rest += singular_values[i] * singular_values[i];
+	}
+
+	return total ? std::sqrt(rest / total) : 0;
+}
+
+std::vector<double> low_rank_template::weights() const
+{
+	const int width = cols * int(hog::dimensions());
+	std::vector<double> w(rows * width, 0);
+	for (unsigned r = 0; r < _rank; r++)
+	{
+		for (int y = 0; y < rows; y++)
+		{
+			for (int i = 0; i < width; i++)
+				w[y * width + i] += column_filters[r * rows + y] * row_filters[r * width + i];
+		}
+	}
+
+	return w;
+}
+
+cv::Mat low_rank_template::operator()(const cv::Mat& features, cv::Size grid) const
+{
+	assert(features.channels() == hog::dimensions());
+	assert(features.rows >= grid.height + rows - 1 && features.cols >= grid.width + cols - 1);
+
+	const int width = cols * int(hog::dimensions());
+	const int levels = grid.height + rows - 1;
+	cv::Mat scores = cv::Mat::zeros(grid.height, grid.width, CV_64FC1);
+	std::vector<double> row_scores(levels * grid.width);
+
+	for (unsigned r = 0; r < _rank; r++)
+	{
+		//
+		// row correlation: the cols x dimensions values of a window row are contiguous
+		//
+		const float * v = &row_filters[r * width];
+		for (int y = 0; y < levels; y++)
+		{
+			const float * row = features.ptr<float>(y);
+			for (int x = 0; x < grid.width; x++)
+			{
+				row_scores[y * grid.width + x] = kernels::dot(v, row + x * hog::dimensions(), width);
+			}
+		}
+
+		//
+		// column correlation
+		//
+		const float * u = &column_filters[r * rows];
+		for (int y = 0; y < grid.height; y++)
+		{
+			double * out = scores.ptr<double>(y);
+			for (int i = 0; i < rows; i++)
+			{
+				const double * in = &row_scores[(y + i) * grid.width];
+				for (int x = 0; x < grid.width; x++)
+					out[x] += u[i] * in[x];
+			}
+		}
+	}
+
+	return scores;
+}
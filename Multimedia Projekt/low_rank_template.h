@@ -0,0 +1,37 @@
+#pragma once
+#include <opencv2/core/core.hpp>	// Mat, Size
+#include <vector>
+
+namespace mmp
+{
+	// approximates a linear template of (rows x cols) hog cells by a sum of rank separable components:
+	// w(y, x, c) ~ sum_r u_r(y) * v_r(x, c)
+	// so scoring a level becomes a row correlation (v_r) followed by a column correlation (u_r)
+	class low_rank_template
+	{
+	private:
+		int rows;
+		int cols;
+		unsigned _rank;
+		std::vector<double> singular_values;
+		std::vector<float> column_filters;	// rank x rows (scaled by the singular values)
+		std::vector<float> row_filters;		// rank x (cols * hog::dimensions)
+
+	public:
+		low_rank_template();
+		// weights are stored like a window returned by mmp::hog (row by row, cell by cell)
+		low_rank_template(const double * weights, int rows, int cols, unsigned rank);
+
+		unsigned rank() const { return _rank; }
+		bool empty() const { return !_rank; }
+		unsigned max_rank() const { return unsigned(singular_values.size()); }
+
+		// relative (frobenius) error of the template approximation using the given rank
+		double residual(unsigned rank) const;
+		// the approximated template (like the weights passed to the constructor)
+		std::vector<double> weights() const;
+
+		// scores (without bias) of every window of grid.width x grid.height cell positions of a mat returned by mmp::hog
+		cv::Mat operator()(const cv::Mat& features, cv::Size grid) const;
+	};
+}
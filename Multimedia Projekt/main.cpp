@@ -4,8 +4,16 @@
 #include "classifier.h"		// classifier
 #include "evaulation.h"		// qualitative_evaluator, quantitative_evaluator, mat_plot
 #include "log.h"
+#include "geometry.h"		// geometry
+#include "hog.h"			// hog
+#include "kernels.h"		// instruction_set, select
+#include "feature_cache.h"	// feature_cache
+#include "archive.h"		// image_archive
+#include "image.h"			// scaled_image
 #include <iostream>			// endl
 #include <thread>
+#include <sstream>			// stringstream
+#include <algorithm>		// max
 #include <opencv2/highgui/highgui.hpp>	// imshow, waitKey
 
 int main(int argc, char ** argv)
@@ -65,6 +73,40 @@ int main(int argc, char ** argv)
 		return 1;
 	}
 
+	//
+	// detection geometry (used by every hog, window and pyramid, so it is selected before anything else)
+	//
+	mmp::geometry geometry;
+	const auto variant = raw_cfg.get_string("hog_variant", "uoccti");
+	geometry.variant = (variant == "dalaltriggs") ? mmp::geometry::DalalTriggs : mmp::geometry::UoCCTi;
+	geometry.cellsize = raw_cfg.get_unsinged("cellsize", geometry.cellsize);
+	geometry.orientations = raw_cfg.get_unsinged("orientations", geometry.orientations);
+	geometry.window_width = raw_cfg.get_unsinged("window_width", geometry.window_width);
+	geometry.window_height = raw_cfg.get_unsinged("window_height", geometry.window_height);
+	geometry.scales_per_octave = raw_cfg.get_unsinged("scales_per_octave", geometry.scales_per_octave);
+	if ((variant != "uoccti" && variant != "dalaltriggs") || !geometry.valid())
+	{
+		mmp::log << "invalid detection geometry [" << geometry.to_string() << "] (the window size has to be a multiple of the cellsize)" << std::endl;
+		return 1;
+	}
+
+	mmp::geometry::select(geometry);
+	mmp::log << "detection geometry: " << geometry.to_string() << std::endl;
+
+	// the kernels default to the best instruction set of the cpu
+	const auto isa = raw_cfg.get_string("instruction_set", "auto");
+	if (isa != "auto")
+	{
+		const mmp::kernels::instruction_set sets[] = { mmp::kernels::generic, mmp::kernels::sse2, mmp::kernels::avx2, mmp::kernels::avx512 };
+		for (auto set : sets)
+		{
+			if (isa == mmp::kernels::name(set) && mmp::kernels::select(set) != set)
+				mmp::log << "instruction set [" << isa << "] not supported" << std::endl;
+		}
+	}
+
+	mmp::log << "kernels: " << mmp::kernels::name(mmp::kernels::selected()) << std::endl;
+
 	cfg = mmp::inria_cfg(
 		raw_cfg.get_string("root"),
 		raw_cfg.get_string("svm"), raw_cfg.get_string("svm_hard"),
@@ -73,6 +115,56 @@ int main(int argc, char ** argv)
 		raw_cfg.get_unsinged("randoms_per_negative", 10),
 		raw_cfg.get_unsinged("num_false_positives", 1218)
 	);
+	cfg.set_cascade(raw_cfg.get_bool("cascade"));
+	cfg.set_coarse_to_fine(raw_cfg.get_unsinged("coarse_stride", 1), raw_cfg.get_double("coarse_margin", 1));
+	cfg.set_pca(raw_cfg.get_bool("pca"), raw_cfg.get_unsinged("pca_dimensions", 12));
+	if (cfg.use_pca() && (cfg.pca_dimensions() == 0 || cfg.pca_dimensions() > mmp::hog::dimensions()))
+	{
+		mmp::log << "invalid [pca_dimensions] = [" << cfg.pca_dimensions() << "] (1 to " << mmp::hog::dimensions() << " for the detection geometry)" << std::endl;
+		return 1;
+	}
+
+	cfg.set_low_rank(raw_cfg.get_unsinged("low_rank"));
+	cfg.set_fft(raw_cfg.get_bool("fft"));
+	cfg.set_quantized(raw_cfg.get_bool("quantized"));
+	mmp::scaled_image::quantize_levels(cfg.use_quantized());
+	cfg.set_compact_features(raw_cfg.get_bool("compact_features"));
+	cfg.set_cell_subdivisions(raw_cfg.get_unsinged("cell_subdivisions", 1));
+	cfg.set_mirroring(raw_cfg.get_bool("mirror_positives"), raw_cfg.get_bool("mirror_hard_negatives"));
+	cfg.set_prefetch(raw_cfg.get_unsinged("io_threads", 2), raw_cfg.get_unsinged("prefetch_depth", 32));
+	cfg.set_archives(raw_cfg.get_bool("archives"));
+	cfg.set_feature_cache_size(raw_cfg.get_unsinged("feature_cache_size"));
+	cfg.set_resume_training(raw_cfg.get_bool("resume_training"));
+
+	std::vector<double> c_grid;
+	std::stringstream grid_values(raw_cfg.get_string("svm_c_grid"));
+	for (double c; grid_values >> c;)
+		c_grid.push_back(c);
+	cfg.set_model_selection(c_grid, std::max(2u, raw_cfg.get_unsinged("cv_folds", 5)), raw_cfg.get_double("cv_fppw", 1e-4));
+	mmp::feature_cache::shared().configure(cfg.feature_cache_size(), cfg.feature_cache_file());
+
+	//
+	// pack the dataset folders into archives (and nothing else)
+	//
+	if (raw_cfg.get_bool("pack_archives"))
+	{
+		const std::string folders[] = { cfg.normalized_positive_train_path(), cfg.negative_train_path(), cfg.normalized_positive_test_path(), cfg.negative_test_path() };
+		for (auto& folder : folders)
+		{
+			if (!mmp::path_exists(folder))
+				continue;
+
+			const auto filename = mmp::image_archive::file_of(folder);
+			mmp::log << "packing [" << folder << "] into [" << filename << "]" << std::endl;
+			if (!mmp::image_archive::pack(folder, filename))
+			{
+				mmp::log << "could not pack [" << folder << "]!" << std::endl;
+				return 1;
+			}
+		}
+
+		return 0;
+	}
 
 	bool skip_training = raw_cfg.get_bool("skip_training");
 	bool skip_eval = raw_cfg.get_bool("skip_eval");
@@ -148,13 +240,31 @@ int main(int argc, char ** argv)
 	{
 		mmp::log << "########### evaluation ###########" << std::endl;
 		mmp::log << "loading svm files ..." << std::endl;
-		std::thread thn = std::thread([&]() { c_normal.load(cfg.svm_file()); });
-		std::thread thh = std::thread([&]() { c_hard.load(cfg.svm_file_hard()); });
+		bool normal_loaded = false, hard_loaded = false;
+		std::thread thn = std::thread([&]() { normal_loaded = c_normal.load(cfg.svm_file()); });
+		std::thread thh = std::thread([&]() { hard_loaded = c_hard.load(cfg.svm_file_hard()); });
 
 		thn.join();
-		mmp::log << cfg.svm_file() << " loaded" << std::endl;
 		thh.join();
+		if (!normal_loaded || !hard_loaded)
+		{
+			mmp::log << "the svm files do not match the configured detection geometry (or feature version)!" << std::endl;
+			return 1;
+		}
+
+		mmp::log << cfg.svm_file() << " loaded" << std::endl;
 		mmp::log << cfg.svm_file_hard() << " loaded" << std::endl;
+
+		c_normal.enable_cascade(cfg.use_cascade());
+		c_hard.enable_cascade(cfg.use_cascade());
+		c_normal.enable_pca(cfg.use_pca());
+		c_hard.enable_pca(cfg.use_pca());
+		c_normal.enable_low_rank(cfg.low_rank());
+		c_hard.enable_low_rank(cfg.low_rank());
+		c_normal.enable_fft(cfg.use_fft());
+		c_hard.enable_fft(cfg.use_fft());
+		c_normal.enable_quantized(cfg.use_quantized());
+		c_hard.enable_quantized(cfg.use_quantized());
 	}
 
 	//
@@ -212,7 +322,17 @@ int main(int argc, char ** argv)
 		
 		mmp::classifier c;
 		mmp::log << mmp::to::both << "loading [" << svm_file << "] ... ";
-		c.load(svm_file);
+		if (!c.load(svm_file))
+		{
+			mmp::log << mmp::to::both << "[" << svm_file << "] ignored" << std::endl;
+			continue;
+		}
+
+		c.enable_cascade(cfg.use_cascade());
+		c.enable_pca(cfg.use_pca());
+		c.enable_low_rank(cfg.low_rank());
+		c.enable_fft(cfg.use_fft());
+		c.enable_quantized(cfg.use_quantized());
 		mmp::log << "done" << std::endl;
 
 		for (j = 0; ; j++)
@@ -227,8 +347,8 @@ int main(int argc, char ** argv)
 				continue;
 			}
 
-			mmp::image i(cv::imread(img_file));
-			i.detect_all(c);
+			mmp::image i(cv::imread(img_file), cfg.cell_subdivisions());
+			i.detect_all(c, 0, cfg.coarse_stride(), cfg.coarse_margin());
 			i.suppress_non_maximum();
 
 			auto img = cv::imread(img_file);
@@ -0,0 +1,115 @@
+#include "prefetch.h"
+#include <opencv2/highgui/highgui.hpp>	// imread
+#include <algorithm>	// max
+#include <utility>		// move
+using namespace mmp;
+
+image_prefetcher::image_prefetcher(const std::vector<std::string>& f, unsigned num_threads, std::size_t d, const image_archive * a, std::vector<bool> s)
+	: files(f), archive(a && a->is_open() ? a : nullptr), skip(std::move(s)), depth(std::max<std::size_t>(1, d)), first(0), next(0), pending(0), stopped(false)
+{
+	for (unsigned i = 0; !archive && i < num_threads; i++)
+		threads.push_back(std::thread([this]() { run(); }));
+}
+
+image_prefetcher::~image_prefetcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopped = true;
+	}
+
+	changed.notify_all();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+void image_prefetcher::extend(std::size_t i)
+{
+	while (first + states.size() <= i)
+	{
+		const auto index = first + states.size();
+		images.emplace_back();
+		states.push_back(index < skip.size() && skip[index] ? taken : unclaimed);
+	}
+}
+
+bool image_prefetcher::find_unclaimed()
+{
+	next = std::max(next, first);
+	for (; next < files.size(); next++)
+	{
+		extend(next);
+		if (states[next - first] == unclaimed)
+			return true;
+	}
+
+	return false;
+}
+
+void image_prefetcher::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		//
+		// claim the first unclaimed image of the list as soon as there is room
+		//
+		changed.wait(lock, [this]() { return stopped || (pending < depth && find_unclaimed()); });
+		if (stopped)
+			return;
+
+		const auto i = next++;
+		pending++;
+		states[i - first] = decoding;
+
+		// the list isn't modified, so it is read without the lock
+		lock.unlock();
+		cv::Mat img = cv::imread(files[i]);
+		lock.lock();
+
+		images[i - first] = img;
+		states[i - first] = decoded;
+		changed.notify_all();
+	}
+}
+
+cv::Mat image_prefetcher::take(std::size_t i)
+{
+	if (archive)
+		return (*archive)[i];
+
+	if (threads.empty())
+		return cv::imread(files[i]);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	extend(i);
+
+	cv::Mat img;
+	if (states[i - first] == unclaimed)
+	{
+		// not reached by the i/o threads: waiting for them could deadlock if all consumers
+		// wait for images beyond the window, so the image is decoded right here
+		states[i - first] = decoding;
+		lock.unlock();
+		img = cv::imread(files[i]);
+		lock.lock();
+	}
+	else
+	{
+		changed.wait(lock, [this, i]() { return states[i - first] == decoded; });
+		std::swap(img, images[i - first]);
+		pending--;
+	}
+
+	states[i - first] = taken;
+
+	while (!states.empty() && states.front() == taken)
+	{
+		images.pop_front();
+		states.pop_front();
+		first++;
+	}
+
+	changed.notify_all();
+	return img;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <opencv2/core/core.hpp>	// Mat
+#include <vector>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "archive.h"
+
+namespace mmp
+{
+	// decodes the images of a file list on its own threads, in the order of the list and at most
+	// depth images ahead of the consumers, so the (openmp) compute threads don't wait for the disk.
+	// every image has to be taken exactly once. images are usually taken roughly in list order, but
+	// an image the i/o threads haven't reached yet is decoded by the taking thread itself, so any
+	// order (e.g. a nonmonotonic openmp schedule) works and never waits for the window to move
+	class image_prefetcher
+	{
+	private:
+		const std::vector<std::string>& files;
+		const image_archive * archive;
+		std::vector<bool> skip;
+		std::size_t depth;
+
+		enum state { unclaimed, decoding, decoded, taken };
+
+		// images [first, first + states.size()) of the list, the taken ones at the front are dropped
+		std::deque<cv::Mat> images;
+		std::deque<state> states;
+		std::size_t first;
+		std::size_t next;		// no image before it is unclaimed
+		std::size_t pending;	// claimed by an i/o thread but not taken
+		bool stopped;
+
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::vector<std::thread> threads;
+
+		image_prefetcher(const image_prefetcher&);
+		image_prefetcher& operator=(const image_prefetcher&);
+
+		void run();
+		// adds the images up to i to the window (mutex held)
+		void extend(std::size_t i);
+		// moves next to the first unclaimed image, false if there is none (mutex held)
+		bool find_unclaimed();
+
+	public:
+		// no threads decode the images on take. the images of an (open) archive aren't decoded
+		// at all, take returns them directly. images i with skip[i] set are neither decoded nor taken
+		image_prefetcher(const std::vector<std::string>& files, unsigned threads, std::size_t depth, const image_archive * archive = nullptr, std::vector<bool> skip = std::vector<bool>());
+		~image_prefetcher();
+
+		// blocks until image i of the list is decoded
+		cv::Mat take(std::size_t i);
+	};
+}
@@ -0,0 +1,86 @@
+#include "pyramid.h"
+#include <opencv2/imgproc/imgproc.hpp>	// resize
+using namespace mmp;
+
+namespace
+{
+	std::vector<std::unique_ptr<gradient_pyramid>> pool;
+}
+
+gradient_pyramid::gradient_pyramid()
+{
+
+}
+
+gradient_pyramid::gradient_pyramid(cv::Mat src, cv::Size min_size, unsigned scales_per_octave)
+{
+	build(src, min_size, scales_per_octave);
+}
+
+void gradient_pyramid::build(cv::Mat src, cv::Size min_size, unsigned scales_per_octave)
+{
+	if (!plan || !plan->matches(src.size(), scales_per_octave, min_size))
+	{
+		plan = pyramid_plan::get(src.size(), scales_per_octave, min_size);
+
+		const auto& planned = plan->levels();
+		const auto pixels = plan->buffer_size();
+		buffer.create(1, int(2 * pixels), CV_32FC1);
+		levels.resize(planned.size());
+		for (std::size_t i = 0; i < planned.size(); i++)
+		{
+			levels[i].scale = planned[i].scale;
+			levels[i].gradients.modulus = cv::Mat(planned[i].size, CV_32FC1, buffer.ptr<float>() + planned[i].offset);
+			levels[i].gradients.angle = cv::Mat(planned[i].size, CV_32FC1, buffer.ptr<float>() + pixels + planned[i].offset);
+		}
+
+		octaves.resize(plan->octaves().size());
+	}
+
+	// only the octave bases depend on each other
+	octaves[0] = src;
+	for (std::size_t i = 1; i < octaves.size(); i++)
+		cv::resize(octaves[i - 1], octaves[i], plan->octaves()[i]);
+
+	// the levels are independent of each other (cv::resize uses its SIMD paths)
+	const auto& planned = plan->levels();
+#pragma omp parallel for schedule(dynamic)
+	for (long i = 0; i < long(levels.size()); i++)
+	{
+		auto& l = levels[i];
+		const auto& base = octaves[planned[i].octave];
+		if (planned[i].size == base.size())
+			hog::gradients(base, l.gradients);
+		else
+		{
+			cv::resize(base, l.image, planned[i].size);
+			hog::gradients(l.image, l.gradients);
+		}
+	}
+
+	octaves[0] = cv::Mat();	// do not keep the source image alive
+}
+
+std::unique_ptr<gradient_pyramid> gradient_pyramid::acquire()
+{
+	std::unique_ptr<gradient_pyramid> pyramid;
+#pragma omp critical(gradient_pyramid_pool)
+	{
+		if (!pool.empty())
+		{
+			pyramid = std::move(pool.back());
+			pool.pop_back();
+		}
+	}
+
+	if (!pyramid)
+		pyramid.reset(new gradient_pyramid());
+
+	return pyramid;
+}
+
+void gradient_pyramid::release(std::unique_ptr<gradient_pyramid> pyramid)
+{
+#pragma omp critical(gradient_pyramid_pool)
+	pool.push_back(std::move(pyramid));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <opencv2/core/core.hpp>	// Mat, Size
+#include <vector>
+#include <memory>	// unique_ptr, shared_ptr
+#include "hog.h"
+#include "pyramid_plan.h"
+
+namespace mmp
+{
+	// image pyramid whose levels are kept as gradient fields only: the gradients and the
+	// orientation binning of a level are computed once and every hog grid of the level
+	// (shifted grids, grids for several models) is extracted from them
+	class gradient_pyramid
+	{
+	public:
+		struct level
+		{
+			float scale;					// of the level relative to the source image
+			hog::gradient_field gradients;	// views of buffer
+			cv::Mat image;					// resize buffer
+		};
+
+	private:
+		// the buffers are kept as long as the images have the resolution of the plan
+		std::shared_ptr<const pyramid_plan> plan;
+		std::vector<level> levels;
+		std::vector<cv::Mat> octaves;	// the source image halved once per octave
+		cv::Mat buffer;					// gradient modulus of all levels followed by their angles
+
+	public:
+		gradient_pyramid();
+		gradient_pyramid(cv::Mat src, cv::Size min_size, unsigned scales_per_octave);
+
+		// builds the levels down to min_size, the levels are computed in parallel
+		void build(cv::Mat src, cv::Size min_size, unsigned scales_per_octave);
+
+		std::vector<level>::size_type size() const { return levels.size(); }
+		// of the last build
+		const pyramid_plan& get_plan() const { return *plan; }
+		const level& operator[](std::vector<level>::size_type i) const { return levels[i]; }
+
+		// pool of pyramids (one per concurrently processed image) whose buffers are reused
+		static std::unique_ptr<gradient_pyramid> acquire();
+		static void release(std::unique_ptr<gradient_pyramid> pyramid);
+	};
+}
@@ -0,0 +1,104 @@
+#include "pyramid_plan.h"
+#include "hog.h"
+#include <cmath>	// pow
+#include <map>
+#include <tuple>
+using namespace mmp;
+
+namespace
+{
+	// source width and height, scales per octave, window width and height, max scale, cellsize
+	typedef std::tuple<int, int, unsigned, int, int, float, unsigned> plan_key;
+	struct cache_entry
+	{
+		std::shared_ptr<const pyramid_plan> plan;
+		unsigned long long last_use;
+	};
+
+	std::map<plan_key, cache_entry> cache;
+	unsigned long long cache_uses = 0;
+
+	int windows(int pixels, int window, int cellsize)
+	{
+		return pixels < window ? 0 : (pixels - window) / cellsize + 1;
+	}
+}
+
+pyramid_plan::pyramid_plan(cv::Size size, unsigned lambda, cv::Size min, float max)
+	: src_size(size), scales_per_octave(lambda), min_size(min), max_scale(max), cellsize(hog::cellsize()), _buffer_size(0)
+{
+	// scale of the level i is step^i, the levels of an octave are resized from its base
+	const float step = std::pow(2.0f, 1.0f / lambda);
+	std::vector<float> octave_scales(1, 1.0f);
+	for (unsigned i = 1; i < lambda; i++)
+		octave_scales.push_back(octave_scales.back() * step);
+
+	_octaves.push_back(size);
+	float scale = 1;
+	for (unsigned i = 0; scale <= max_scale; i++)
+	{
+		const unsigned octave = i / lambda;
+		const unsigned mod = i % lambda;
+		if (octave == _octaves.size())
+			_octaves.push_back(cv::Size(int(_octaves.back().width / 2.0f), int(_octaves.back().height / 2.0f)));
+
+		const auto& base = _octaves[octave];
+		const cv::Size level_size(int(base.width / octave_scales[mod]), int(base.height / octave_scales[mod]));
+		if (level_size.width < min_size.width || level_size.height < min_size.height)
+			break;
+
+		const cv::Size grid(windows(level_size.width, min_size.width, cellsize), windows(level_size.height, min_size.height, cellsize));
+		level l = { scale, octave, level_size, grid, _buffer_size };
+		_levels.push_back(l);
+		_buffer_size += level_size.area();
+
+		scale *= step;
+	}
+
+	// the last octave may not have been used
+	_octaves.resize(_levels.empty() ? 1 : _levels.back().octave + 1);
+}
+
+std::shared_ptr<const pyramid_plan> pyramid_plan::get(cv::Size size, unsigned scales_per_octave, cv::Size min_size, float max_scale)
+{
+	const plan_key key(size.width, size.height, scales_per_octave, min_size.width, min_size.height, max_scale, hog::cellsize());
+	std::shared_ptr<const pyramid_plan> plan;
+#pragma omp critical(pyramid_plan_cache)
+	{
+		auto i = cache.find(key);
+		if (i == cache.end())
+		{
+			// plans in use by pyramids stay alive when they are dropped from the cache
+			if (cache.size() >= max_cached)
+			{
+				auto oldest = cache.begin();
+				for (auto j = cache.begin(); j != cache.end(); ++j)
+				{
+					if (j->second.last_use < oldest->second.last_use)
+						oldest = j;
+				}
+
+				cache.erase(oldest);
+			}
+
+			cache_entry entry = { std::shared_ptr<const pyramid_plan>(new pyramid_plan(size, scales_per_octave, min_size, max_scale)), 0 };
+			i = cache.insert(std::make_pair(key, entry)).first;
+		}
+
+		i->second.last_use = ++cache_uses;
+		plan = i->second.plan;
+	}
+
+	return plan;
+}
+
+bool pyramid_plan::matches(cv::Size size, unsigned lambda, cv::Size min, float max) const
+{
+	return size == src_size && lambda == scales_per_octave && min == min_size && max == max_scale && cellsize == hog::cellsize();
+}
+
+cv::Size pyramid_plan::window_grid(std::size_t level, cv::Point offset) const
+{
+	const auto& size = _levels[level].size;
+	return cv::Size(windows(size.width - offset.x, min_size.width, cellsize), windows(size.height - offset.y, min_size.height, cellsize));
+}
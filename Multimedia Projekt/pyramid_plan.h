@@ -0,0 +1,53 @@
+#pragma once
+#include <opencv2/core/core.hpp>	// Size
+#include <vector>
+#include <memory>	// shared_ptr
+#include <limits>	// numeric_limits
+
+namespace mmp
+{
+	// the levels of an image pyramid for one input resolution: scale factors, level sizes, window
+	// grids and the offsets of the levels in one buffer (in pixels). plans are immutable and built
+	// once per resolution, so they are shared between threads and images without locking
+	class pyramid_plan
+	{
+	public:
+		struct level
+		{
+			float scale;		// of the level relative to the source image
+			unsigned octave;	// the level is resized from the base of this octave
+			cv::Size size;
+			cv::Size windows;	// window positions (at cell stride) of the unshifted hog grid
+			std::size_t offset;
+		};
+
+	private:
+		cv::Size src_size;
+		unsigned scales_per_octave;
+		cv::Size min_size;	// the detection window
+		float max_scale;
+		unsigned cellsize;
+
+		std::vector<level> _levels;
+		std::vector<cv::Size> _octaves;	// the source size halved once per octave
+		std::size_t _buffer_size;
+
+	private:
+		pyramid_plan(cv::Size size, unsigned scales_per_octave, cv::Size min_size, float max_scale);
+
+	public:
+		// the (cached) plan of the levels down to min_size (the detection window) and up to max_scale,
+		// at most max_cached plans (resolutions) are kept
+		static const std::size_t max_cached = 32;
+		static std::shared_ptr<const pyramid_plan> get(cv::Size size, unsigned scales_per_octave, cv::Size min_size, float max_scale = std::numeric_limits<float>::infinity());
+
+		bool matches(cv::Size size, unsigned scales_per_octave, cv::Size min_size, float max_scale = std::numeric_limits<float>::infinity()) const;
+
+		const std::vector<level>& levels() const { return _levels; }
+		// window positions of the hog grid of a level shifted by offset pixels (empty if no window fits)
+		cv::Size window_grid(std::size_t level, cv::Point offset) const;
+		const std::vector<cv::Size>& octaves() const { return _octaves; }
+		// pixels of all levels
+		std::size_t buffer_size() const { return _buffer_size; }
+	};
+}
@@ -0,0 +1,85 @@
+#include "quantized_template.h"
+#include "hog.h"
+#include "kernels.h"
+#include <cmath>		// fabs, floor
+#include <cassert>
+#include <algorithm>	// max, min
+using namespace mmp;
+
+quantized_template::quantized_template()
+	: rows(0), cols(0), weight_scale(1)
+{
+
+}
+
+quantized_template::quantized_template(const double * w, int rows, int cols)
+	: rows(rows), cols(cols), weights(rows * cols * hog::dimensions())
+{
+	double max = 0;
+	for (auto i = 0u; i < weights.size(); i++)
+		max = std::max(max, std::fabs(w[i]));
+
+	weight_scale = max ? max / 127 : 1;
+	for (auto i = 0u; i < weights.size(); i++)
+		weights[i] = short(std::floor(w[i] / weight_scale + 0.5));
+}
+
+cv::Mat quantized_template::quantize(const cv::Mat& features, double& scale)
+{
+	assert(features.channels() == hog::dimensions());
+	const int width = features.cols * int(hog::dimensions());
+
+	float max = 0;
+	for (int y = 0; y < features.rows; y++)
+	{
+		const float * f = features.ptr<float>(y);
+		for (int i = 0; i < width; i++)
+			max = std::max(max, f[i]);
+	}
+
+	scale = max ? double(max) / 255 : 1;
+	const float inverse = float(1 / scale);
+	cv::Mat quantized(features.rows, features.cols, CV_8UC(int(hog::dimensions())));
+	for (int y = 0; y < features.rows; y++)
+	{
+		const float * f = features.ptr<float>(y);
+		uchar * q = quantized.ptr<uchar>(y);
+		for (int i = 0; i < width; i++)
+			q[i] = uchar(std::min(255.0f, std::max(0.0f, f[i] * inverse + 0.5f)));
+	}
+
+	return quantized;
+}
+
+cv::Mat quantized_template::operator()(const cv::Mat& features, cv::Size grid) const
+{
+	double feature_scale;
+	const cv::Mat quantized = quantize(features, feature_scale);
+	return (*this)(quantized, feature_scale, grid);
+}
+
+cv::Mat quantized_template::operator()(const cv::Mat& quantized, double feature_scale, cv::Size grid) const
+{
+	assert(quantized.depth() == CV_8U && quantized.channels() == hog::dimensions());
+	assert(quantized.rows >= grid.height + rows - 1 && quantized.cols >= grid.width + cols - 1);
+
+	const double scale = feature_scale * weight_scale;
+
+	// the cols x dimensions values of a window row are contiguous
+	const int width = cols * int(hog::dimensions());
+	cv::Mat scores(grid.height, grid.width, CV_64FC1);
+	for (int y = 0; y < grid.height; y++)
+	{
+		double * out = scores.ptr<double>(y);
+		for (int x = 0; x < grid.width; x++)
+		{
+			int sum = 0;
+			for (int i = 0; i < rows; i++)
+				sum += kernels::dot(quantized.ptr<uchar>(y + i) + x * hog::dimensions(), &weights[i * width], width);
+
+			out[x] = sum * scale;
+		}
+	}
+
+	return scores;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <opencv2/core/core.hpp>	// Mat, Size
+#include <vector>
+
+namespace mmp
+{
+	// int8 version of a linear template of (rows x cols) hog cells, scoring uint8 quantized levels with integer arithmetic
+	class quantized_template
+	{
+	private:
+		int rows;
+		int cols;
+		std::vector<short> weights;	// int8 values (widened to 16 bit for the multiply-add)
+		double weight_scale;
+
+	public:
+		quantized_template();
+		// weights are stored like a window returned by mmp::hog (row by row, cell by cell)
+		quantized_template(const double * weights, int rows, int cols);
+
+		bool empty() const { return weights.empty(); }
+
+		// quantizes a mat returned by mmp::hog to uint8 (uocctti features are non-negative)
+		// the original values are approximately scale * quantized
+		static cv::Mat quantize(const cv::Mat& features, double& scale);
+
+		// scores (without bias) of every window of grid.width x grid.height cell positions of a mat returned by mmp::hog
+		cv::Mat operator()(const cv::Mat& features, cv::Size grid) const;
+		// as above for a mat already quantized by quantize (with the scale it returned)
+		cv::Mat operator()(const cv::Mat& quantized, double feature_scale, cv::Size grid) const;
+	};
+}
@@ -0,0 +1,172 @@
+#include "scratch.h"
+#include "geometry.h"
+#include <vl/hog.h>
+#include <boost/thread/tss.hpp>	// thread_specific_ptr
+#include <atomic>
+#include <cassert>
+using namespace mmp;
+
+#ifdef _MSC_VER
+#define MMP_THREAD_LOCAL __declspec(thread)
+#else
+#define MMP_THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+	// maximum number of recycled vectors and vl_hog objects kept per thread
+	const std::size_t max_spares = 256;
+	const std::size_t max_extractors = 64;
+
+	struct vl_extractor
+	{
+		geometry g;
+		int width;
+		int height;
+		VlHog * hog;
+		unsigned long long last_use;
+	};
+
+	struct arena
+	{
+		std::vector<std::vector<float>> buffers;
+		std::size_t depth;					// number of borrowed buffers
+		std::vector<std::vector<float>> spares;
+		std::vector<vl_extractor> extractors;
+		unsigned long long uses;
+
+		arena() : depth(0), uses(0) { }
+		~arena()
+		{
+			for (auto& e : extractors)
+				vl_hog_delete(e.hog);
+		}
+	};
+
+	std::atomic<unsigned long long> allocations(0);
+	std::atomic<unsigned long long> allocated_bytes(0);
+	std::atomic<unsigned long long> extractors_created(0);
+
+	// the arena lives as long as its thread: the owner deletes it (with its vl_hog objects) when
+	// the thread exits, which matters for the std::threads (loaders, prefetchers, evaluators)
+	boost::thread_specific_ptr<arena> arena_owner;
+	// plain thread local copy of the owned pointer for the fast path
+	MMP_THREAD_LOCAL arena * local_arena = nullptr;
+
+	arena& local()
+	{
+		if (!local_arena)
+		{
+			local_arena = new arena();
+			arena_owner.reset(local_arena);
+		}
+
+		return *local_arena;
+	}
+
+	void count_allocation(std::size_t values)
+	{
+		allocations++;
+		allocated_bytes += values * sizeof(float);
+	}
+}
+
+scratch::buffer::buffer(std::size_t size)
+	: _size(size)
+{
+	auto& a = local();
+	if (a.depth == a.buffers.size())
+		a.buffers.emplace_back();
+
+	auto& values = a.buffers[a.depth++];
+	if (values.size() < size)
+	{
+		count_allocation(size);
+		values.resize(size);
+	}
+
+	_data = values.data();
+}
+
+scratch::buffer::~buffer()
+{
+	auto& a = local();
+	assert(a.depth && a.buffers[a.depth - 1].data() == _data && "scratch buffers are released in reverse order");
+	a.depth--;
+}
+
+std::vector<float> scratch::take(std::size_t size)
+{
+	auto& a = local();
+
+	// smallest spare large enough
+	std::size_t best = a.spares.size();
+	for (std::size_t i = 0; i < a.spares.size(); i++)
+	{
+		const auto capacity = a.spares[i].capacity();
+		if (capacity >= size && (best == a.spares.size() || capacity < a.spares[best].capacity()))
+			best = i;
+	}
+
+	std::vector<float> values;
+	if (best < a.spares.size())
+	{
+		values = std::move(a.spares[best]);
+		if (best + 1 < a.spares.size())
+			a.spares[best] = std::move(a.spares.back());
+
+		a.spares.pop_back();
+	}
+	else
+		count_allocation(size);
+
+	values.resize(size);
+	return values;
+}
+
+void scratch::recycle(std::vector<float>&& values)
+{
+	auto& a = local();
+	if (values.capacity() && a.spares.size() < max_spares)
+		a.spares.push_back(std::move(values));
+}
+
+void * scratch::extractor(int width, int height)
+{
+	auto& a = local();
+	const auto& g = geometry::active();
+	a.uses++;
+
+	std::size_t oldest = 0;
+	for (std::size_t i = 0; i < a.extractors.size(); i++)
+	{
+		auto& e = a.extractors[i];
+		if (e.width == width && e.height == height && e.g == g)
+		{
+			e.last_use = a.uses;
+			return e.hog;
+		}
+
+		if (e.last_use < a.extractors[oldest].last_use)
+			oldest = i;
+	}
+
+	// vl_hog reallocates its histograms for every other image size, so there is one object per size
+	vl_extractor e = { g, width, height, vl_hog_new(g.variant == geometry::DalalTriggs ? VlHogVariantDalalTriggs : VlHogVariantUoctti, g.orientations, VL_FALSE), a.uses };
+	extractors_created++;
+	if (a.extractors.size() < max_extractors)
+		a.extractors.push_back(e);
+	else
+	{
+		vl_hog_delete(a.extractors[oldest].hog);
+		a.extractors[oldest] = e;
+	}
+
+	return e.hog;
+}
+
+scratch::statistics scratch::counters()
+{
+	statistics s = { allocations, allocated_bytes, extractors_created };
+	return s;
+}
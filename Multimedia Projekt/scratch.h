@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <cstddef>	// size_t
+
+namespace mmp
+{
+	// per-thread pools for the temporaries (and the recycled results) of the feature extraction.
+	// pooled memory keeps its capacity, so once warmed up the extraction does no heap allocation
+	class scratch
+	{
+	public:
+		struct statistics
+		{
+			unsigned long long allocations;	// pooled buffers created or grown
+			unsigned long long bytes;		// allocated by these
+			unsigned long long extractors;	// vl_hog objects created
+		};
+
+		// float buffer of the calling thread's pool, borrowed for the lifetime of this object
+		// (buffers have to be released in reverse order, which scoped objects guarantee)
+		class buffer
+		{
+		private:
+			float * _data;
+			std::size_t _size;
+
+			buffer(const buffer&);
+			buffer& operator=(const buffer&);
+
+		public:
+			explicit buffer(std::size_t size);
+			~buffer();
+
+			float * data() const { return _data; }
+			std::size_t size() const { return _size; }
+		};
+
+	public:
+		// a vector of size values, which reuses the memory of a recycled vector if possible
+		static std::vector<float> take(std::size_t size);
+		static void recycle(std::vector<float>&& values);
+
+		// vl_hog object (VlHog *) of the active geometry for images of width x height,
+		// it belongs to the calling thread and must not be deleted
+		static void * extractor(int width, int height);
+
+		// of all threads
+		static statistics counters();
+	};
+}
@@ -4,7 +4,10 @@ extern "C" {
 #include "svm_learn.h"
 }
 #include <cstring>		// strcpy
-#include <algorithm>	// swap
+#include <algorithm>	// swap, min, max
+#include <cmath>		// floor
+#include <istream>
+#include <ostream>
 using namespace svm;
 
 namespace
@@ -44,12 +47,22 @@ namespace
 
 void sparse_vector::const_iterator::operator++()
 {
+	if (((const SVECTOR *)_svector)->qwords)
+	{
+		_ptr = (unsigned char *)_ptr + 1;
+		return;
+	}
+
 	auto word = (WORD *)_ptr;
 	_ptr = ++word;
 }
 
 sparse_vector::value_type sparse_vector::const_iterator::operator*() const
 {
+	auto svector = (const SVECTOR *)_svector;
+	if (svector->qwords)
+		return value_type(*(unsigned char *)_ptr * svector->qscale);
+
 	// even though FVAL might be double a conversation to float
 	// does not result in information loss because sparse_vector
 	// doesn't fill it with doubles in the first place
@@ -58,29 +71,50 @@ sparse_vector::value_type sparse_vector::const_iterator::operator*() const
 
 sparse_vector::size_type sparse_vector::const_iterator::index() const
 {
+	auto svector = (const SVECTOR *)_svector;
+	if (svector->qwords)
+		return size_type((unsigned char *)_ptr - svector->qwords) + 1;
+
 	return ((WORD *)_ptr)->wnum;
 }
 
 void sparse_vector::svector_init(void ** svector, const std::vector<sparse_vector::word>& words, void ** words_end)
 {
-	std::vector<WORD> _words;
-	_words.reserve(words.size() + 1);
-	for (auto& word : words)
+	// the words are written directly into the (single block) svector
+	auto vec = alloc_svector((long)words.size(), const_cast<char *>(""), 1);
+	for (std::size_t i = 0; i < words.size(); i++)
 	{
-		WORD w = { word.first, word.second };
-		_words.push_back(std::move(w));
+		vec->words[i].wnum = words[i].first;
+		vec->words[i].weight = words[i].second;
 	}
-	WORD w;
-	w.wnum = 0;
-	_words.push_back(std::move(w));
+	vec->twonorm_sq = sprod_ss(vec, vec);
 
-	auto vec = create_svector(_words.data(), const_cast<char *>(""), 1);
 	*svector = vec;
+	*words_end = vec->words + words.size();
+}
+
+void sparse_vector::quantized_init(void ** svector, const std::vector<value_type>& values, void ** words_end)
+{
+	value_type max = 0;
+	for (auto value : values)
+	{
+		assert(value >= 0 && "quantized sparse_vectors only support non-negative values");
+		max = std::max(max, value);
+	}
+
+	const double scale = max > 0 ? max / 255.0 : 1;
+	std::vector<unsigned char> qwords(values.size());
+	for (std::size_t i = 0; i < values.size(); i++)
+		qwords[i] = (unsigned char)std::min(255.0, std::max(0.0, std::floor(values[i] / scale + 0.5)));
 
-	WORD * end = vec->words;
-	while (end->wnum)
-		++end;
-	*words_end = end;
+	auto vec = create_svector_quantized(qwords.data(), (long)qwords.size(), scale, const_cast<char *>(""), 1);
+	*svector = vec;
+	*words_end = vec->qwords + vec->qnum;
+}
+
+double sparse_vector::quantization_step() const
+{
+	return ((const SVECTOR *)_svector)->qwords ? ((const SVECTOR *)_svector)->qscale : 0;
 }
 
 sparse_vector& sparse_vector::operator=(sparse_vector&& rhs)
@@ -113,9 +147,92 @@ sparse_vector::sparse_vector(sparse_vector&& rhs)
 	rhs._words_end = nullptr;
 }
 
+void sparse_vector::write(std::ostream& out) const
+{
+	//
+	// size, quantized flag and either the 8 bit values with their step or the word count and the words
+	//
+	auto svector = (const SVECTOR *)_svector;
+	const char quantized = svector->qwords ? 1 : 0;
+	out.write((const char *)&_size, sizeof(_size));
+	out.write(&quantized, sizeof(quantized));
+	if (quantized)
+	{
+		out.write((const char *)&svector->qscale, sizeof(svector->qscale));
+		out.write((const char *)&svector->qnum, sizeof(svector->qnum));
+		out.write((const char *)svector->qwords, svector->qnum);
+		return;
+	}
+
+	const long words = long((WORD *)_words_end - svector->words);
+	out.write((const char *)&words, sizeof(words));
+	for (long i = 0; i < words; i++)
+	{
+		out.write((const char *)&svector->words[i].wnum, sizeof(svector->words[i].wnum));
+		out.write((const char *)&svector->words[i].weight, sizeof(svector->words[i].weight));
+	}
+}
+
+sparse_vector sparse_vector::read(std::istream& in)
+{
+	// returned if nothing could be read
+	const std::vector<value_type> none;
+
+	size_type size = 0;
+	char quantized = 0;
+	long count = 0;
+	in.read((char *)&size, sizeof(size));
+	in.read(&quantized, sizeof(quantized));
+	if (quantized)
+	{
+		double qscale = 0;
+		in.read((char *)&qscale, sizeof(qscale));
+		in.read((char *)&count, sizeof(count));
+		if (!in || count < 0 || count > size)
+		{
+			in.setstate(std::ios::failbit);
+			return sparse_vector(none.begin(), none.end(), 0);
+		}
+
+		std::vector<unsigned char> qwords(count);
+		in.read((char *)qwords.data(), count);
+		if (!in)
+			return sparse_vector(none.begin(), none.end(), 0);
+
+		auto vec = create_svector_quantized(qwords.data(), count, qscale, const_cast<char *>(""), 1);
+		return sparse_vector(vec, vec->qwords + vec->qnum, size);
+	}
+
+	in.read((char *)&count, sizeof(count));
+	if (!in || count < 0 || count > size)
+	{
+		in.setstate(std::ios::failbit);
+		return sparse_vector(none.begin(), none.end(), 0);
+	}
+
+	auto vec = alloc_svector(count, const_cast<char *>(""), 1);
+	for (long i = 0; i < count; i++)
+	{
+		in.read((char *)&vec->words[i].wnum, sizeof(vec->words[i].wnum));
+		in.read((char *)&vec->words[i].weight, sizeof(vec->words[i].weight));
+	}
+	if (!in)
+	{
+		free_svector(vec);
+		return sparse_vector(none.begin(), none.end(), 0);
+	}
+
+	vec->twonorm_sq = sprod_ss(vec, vec);
+	return sparse_vector(vec, vec->words + count, size);
+}
+
 sparse_vector::const_iterator sparse_vector::begin() const
 {
-	return const_iterator(((SVECTOR *)_svector)->words);
+	auto svector = (SVECTOR *)_svector;
+	if (svector->qwords)
+		return const_iterator(svector->qwords, _svector);
+
+	return const_iterator(svector->words, _svector);
 }
 
 sparse_vector::~sparse_vector()
@@ -137,11 +254,6 @@ std::string svm::to_string(const sparse_vector& svec)
 	return str;
 }
 
-void * svm::linear_model::create_doc(sparse_vector::size_type index, const sparse_vector& svec, double costfactor) const
-{
-	return create_example(index, 0, 0, costfactor, const_cast<SVECTOR *>(static_cast<const SVECTOR *>(svec.c_ptr())));
-}
-
 svm::linear_model::linear_model(const std::string& filename)
 {
 	_model = read_model(const_cast<char *>(filename.c_str()));
@@ -151,8 +263,21 @@ svm::linear_model::linear_model(const std::string& filename)
 	_b = ((MODEL *)_model)->b;
 }
 
-void svm::linear_model::model_init(void ** model, double ** linear_weights, double * b, std::vector<void *>& docs, std::vector<double>& targets, sparse_vector::size_type vec_size, double c)
+void svm::linear_model::model_init(void ** model, double ** linear_weights, double * b, const std::vector<const void *>& svectors, std::vector<double>& targets, sparse_vector::size_type vec_size, double c)
 {
+	// one array of DOCs instead of a create_example (malloc) per training window
+	std::vector<DOC> examples(svectors.size());
+	std::vector<DOC *> docs(svectors.size());
+	for (std::size_t i = 0; i < svectors.size(); i++)
+	{
+		examples[i].docnum = (long)i;
+		examples[i].queryid = 0;
+		examples[i].costfactor = 1;
+		examples[i].slackid = 0;
+		examples[i].fvec = const_cast<SVECTOR *>(static_cast<const SVECTOR *>(svectors[i]));
+		docs[i] = &examples[i];
+	}
+
 	LEARN_PARM learn_param;
 	KERNEL_PARM kernel_param;
 	params_init(&learn_param, &kernel_param);
@@ -162,17 +287,19 @@ void svm::linear_model::model_init(void ** model, double ** linear_weights, doub
 	learn_param.skip_final_opt_check = 0;
 	kernel_param.kernel_type = LINEAR;
 
+	// the training has its own svm_light state, so several models can be trained concurrently
+	SVM_CONTEXT context;
+	init_context(&context);
 	MODEL * mod = (MODEL *)malloc(sizeof(MODEL));
-	svm_learn_classification((DOC **)docs.data(), targets.data(), (long)docs.size(), vec_size, &learn_param, &kernel_param, nullptr, mod, nullptr);
+	svm_learn_classification(docs.data(), targets.data(), (long)docs.size(), vec_size, &learn_param, &kernel_param, nullptr, mod, nullptr, &context);
+	cleanup_context(&context);
 	add_weight_vector_to_linear_model(mod);
-	// copy the model so we have our own copy of the support vectors
+	// copy the model so we have our own copy of the support vectors (in a single allocation)
 	*model = copy_model(mod);
 	*linear_weights = ((MODEL *)*model)->lin_weights;
 	*b = ((MODEL *)*model)->b;
 
 	free_model(mod, 0);
-	for (auto& doc : docs)
-		free_example((DOC *)doc, 0); // we are not owning the svectors
 }
 
 svm::linear_model::~linear_model()
@@ -186,11 +313,32 @@ void svm::linear_model::save(const std::string& filename) const
 	write_model(const_cast<char *>(filename.c_str()), (MODEL *)_model);
 }
 
+std::string svm::linear_model::get_description() const
+{
+	// svm_light keeps it as the (unused) custom kernel parameter
+	std::string description = ((MODEL *)_model)->kernel_parm.custom;
+	while (!description.empty() && description.back() == ' ')
+		description.pop_back();
+
+	return description;
+}
+
+void svm::linear_model::set_description(const std::string& description)
+{
+	assert(description.find('#') == std::string::npos && "the model file uses # for comments");
+	auto& custom = ((MODEL *)_model)->kernel_parm.custom;
+	std::strncpy(custom, description.c_str(), sizeof(custom) - 1);
+	custom[sizeof(custom) - 1] = '\0';
+}
+
 double svm::linear_model::classify(const sparse_vector& svec) const
 {
 	assert(svec.size() <= vec_size && "Invalid vec size!");
-	auto doc = create_doc(-1, svec, 0);
-	double value = classify_example_linear((MODEL *)_model, (DOC *)doc);
-	free_example((DOC *)doc, 0);
-	return value;
+	DOC doc;
+	doc.docnum = -1;
+	doc.queryid = 0;
+	doc.costfactor = 0;
+	doc.slackid = 0;
+	doc.fvec = const_cast<SVECTOR *>(static_cast<const SVECTOR *>(svec.c_ptr()));
+	return classify_example_linear((MODEL *)_model, &doc);
 }
\ No newline at end of file
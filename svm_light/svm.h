@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <iosfwd>	// istream, ostream
 #include <cmath>	// fabs
 #include <utility>	// move, pair
 #include <cassert>
@@ -19,9 +20,10 @@ namespace svm
 
 		private:
 			void * _ptr;
+			const void * _svector;
 
 		private:
-			const_iterator(void * ptr) : _ptr(ptr) { }
+			const_iterator(void * ptr, const void * svector) : _ptr(ptr), _svector(svector) { }
 
 		public:
 			size_type index() const;
@@ -40,16 +42,35 @@ namespace svm
 	private:
 		typedef std::pair<size_type, value_type> word;
 		static void svector_init(void ** svector, const std::vector<word>& words, void ** words_end);
+		// dense 8 bit storage (for non-negative values)
+		static void quantized_init(void ** svector, const std::vector<value_type>& values, void ** words_end);
+
+		sparse_vector(void * svector, void * words_end, size_type size) : _size(size), _svector(svector), _words_end(words_end) { }
 
 	public:
 		//sparse_vector(const sparse_vector& rhs);
 		sparse_vector(sparse_vector&& rhs);
 		sparse_vector& operator=(sparse_vector&& rhs);
 
+		// quantize stores the (non-negative) values with 8 bit (dense) instead of index/float pairs
 		template<class T>
-		sparse_vector(T begin, T end, size_type size)
+		sparse_vector(T begin, T end, size_type size, bool quantize = false)
 			: _size(size)
 		{
+			if (quantize)
+			{
+				std::vector<value_type> values;
+				values.reserve(size);
+				while (begin != end)
+				{
+					values.push_back(*begin);
+					++begin;
+				}
+
+				quantized_init(&_svector, values, &_words_end);
+				return;
+			}
+
 			std::vector<word> words;
 			words.reserve(size);
 			size_type i = 1;
@@ -69,9 +90,17 @@ namespace svm
 
 		const void * c_ptr() const { return _svector; }
 		size_type size() const { return _size; }
+		// quantization step of the values (0 if the vector is not quantized)
+		double quantization_step() const;
 
+		// quantized vectors iterate all values (including zeros)
 		const_iterator begin() const;
-		const_iterator end() const { return const_iterator(_words_end); }
+		const_iterator end() const { return const_iterator(_words_end, _svector); }
+
+		// binary, the values are restored exactly (quantized vectors stay quantized).
+		// read sets the failbit of in if it could not read a vector
+		void write(std::ostream& out) const;
+		static sparse_vector read(std::istream& in);
 	};
 
 	std::string to_string(const sparse_vector& svec);
@@ -85,9 +114,8 @@ namespace svm
 		double _b;
 
 	private:
-		static void model_init(void ** model, double ** linear_weights, double * b, std::vector<void *>& docs, std::vector<double>& targets, sparse_vector::size_type vec_size, double c);
-		// creates a DOC for a given sparse_vector (which has to be owned on the DOCs livespan)
-		void * create_doc(sparse_vector::size_type index, const sparse_vector& svec, double costfactor = 1) const;
+		// the DOCs of the svectors (which have to be owned during the training) are created in a single array
+		static void model_init(void ** model, double ** linear_weights, double * b, const std::vector<const void *>& svectors, std::vector<double>& targets, sparse_vector::size_type vec_size, double c);
 
 	public:
 		linear_model(const std::string& filename);
@@ -97,30 +125,34 @@ namespace svm
 			: vec_size(vec_size)
 		{
 
-			std::vector<void *> docs;
+			std::vector<const void *> svectors;
 			std::vector<double> targets;
-			docs.reserve(negatives.size() + positives.size());
+			svectors.reserve(negatives.size() + positives.size());
 			targets.insert(targets.end(), positives.size(), +1);
 			targets.insert(targets.end(), negatives.size(), -1);
 
-			for (auto& positive : positives)
+			// the containers may also hold references (std::reference_wrapper) to sparse_vectors
+			for (const sparse_vector& positive : positives)
 			{
 				assert(positive.size() == vec_size);
-				docs.push_back(create_doc((sparse_vector::size_type)docs.size(), positive));
+				svectors.push_back(positive.c_ptr());
 			}
 
-			for (auto& negative : negatives)
+			for (const sparse_vector& negative : negatives)
 			{
 				assert(negative.size() == vec_size);
-				docs.push_back(create_doc((sparse_vector::size_type)docs.size(), negative));
+				svectors.push_back(negative.c_ptr());
 			}
 
-			model_init(&_model, &_linear_weights, &_b, docs, targets, vec_size, c);
+			model_init(&_model, &_linear_weights, &_b, svectors, targets, vec_size, c);
 		}
 
 		~linear_model();
 
 		sparse_vector::size_type get_vec_size() const { return vec_size; }
+		// weights are indexed like the sparse_vector features (starting at 1)
+		const double * get_weights() const { return _linear_weights; }
+		double get_bias() const { return _b; }
 
 		double classify(const sparse_vector& vec) const;
 		
@@ -141,6 +173,10 @@ namespace svm
 		}
 
 		void save(const std::string& filename) const;
+
+		// free text stored in the model file (at most 49 characters, no '#')
+		std::string get_description() const;
+		void set_description(const std::string& description);
 	};
 }
 
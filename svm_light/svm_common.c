@@ -17,11 +17,71 @@
 /************************************************************************/
 
 # include "ctype.h"
+# include <assert.h>
 # include "svm_common.h"
 # include "kernel.h"           /* this contains a user supplied kernel */
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
+# if defined(_MSC_VER)
+#  define SVM_THREAD_LOCAL __declspec(thread)
+# else
+#  define SVM_THREAD_LOCAL __thread
+# endif
+
+/* the context installed by set_svm_context or the thread's own one */
+static SVM_THREAD_LOCAL SVM_CONTEXT *current_context=NULL;
+static SVM_THREAD_LOCAL SVM_CONTEXT thread_context;
+static SVM_THREAD_LOCAL int thread_context_ready=0;
+
+void init_context(SVM_CONTEXT *context)
+{
+  context->verbosity=0;
+  context->kernel_cache_statistic=0;
+  context->primal=NULL;
+  context->dual=NULL;
+  context->precision_violations=0;
+  context->opt_precision=DEF_PRECISION;
+  context->maxiter=DEF_MAX_ITERATIONS;
+  context->lindep_sensitivity=DEF_LINDEP_SENSITIVITY;
+  context->buffer=NULL;
+  context->nonoptimal=NULL;
+  context->smallroundcount=0;
+  context->roundnumber=0;
+  context->switchsens=0.0;
+  context->switchsensorg=0.0;
+  context->switchnum=0;
+}
 
-long   verbosity;              /* verbosity level (0-4) */
-long   kernel_cache_statistic;
+void cleanup_context(SVM_CONTEXT *context)
+     /* frees the buffers of the qp solver */
+{
+  free(context->primal);
+  free(context->dual);
+  free(context->buffer);
+  free(context->nonoptimal);
+  init_context(context);
+}
+
+SVM_CONTEXT *svm_context(void)
+{
+  if(current_context)
+    return(current_context);
+  if(!thread_context_ready) {
+    init_context(&thread_context);
+    thread_context_ready=1;
+  }
+  return(&thread_context);
+}
+
+SVM_CONTEXT *set_svm_context(SVM_CONTEXT *context)
+     /* NULL selects the thread's own context again */
+{
+  SVM_CONTEXT *previous=svm_context();
+  current_context=context;
+  return(previous);
+}
 
 double classify_example(MODEL *model, DOC *ex) 
      /* classifies one example */
@@ -79,7 +139,7 @@ double kernel(KERNEL_PARM *kernel_parm, DOC *a, DOC *b)
 double single_kernel(KERNEL_PARM *kernel_parm, SVECTOR *a, SVECTOR *b) 
      /* calculate the kernel function between two vectors */
 {
-  kernel_cache_statistic++;
+  svm_context()->kernel_cache_statistic++;
   switch(kernel_parm->kernel_type) {
     case 0: /* linear */ 
             return(sprod_ss(a,b)); 
@@ -107,10 +167,14 @@ SVECTOR *create_svector(WORD *words,char *userdefined,double factor)
   }
   fnum++;
   vec = (SVECTOR *)my_malloc(sizeof(SVECTOR));
+  vec->packed=SVECTOR_SEPARATE;
   vec->words = (WORD *)my_malloc(sizeof(WORD)*(fnum));
   for(i=0;i<fnum;i++) { 
       vec->words[i]=words[i];
   }
+  vec->qwords=NULL;
+  vec->qnum=0;
+  vec->qscale=0;
   vec->twonorm_sq=sprod_ss(vec,vec);
 
   fnum=0;
@@ -128,10 +192,65 @@ SVECTOR *create_svector(WORD *words,char *userdefined,double factor)
   return(vec);
 }
 
+SVECTOR *alloc_svector(long fnum, char *userdefined, double factor)
+     /* allocates a vector for fnum features together with its words
+	(terminated) and userdefined in a single block, so the caller
+	can fill in the words without building a temporary array first.
+	twonorm_sq has to be set once the words are filled in. */
+{
+  SVECTOR *vec;
+  size_t  length;
+
+  length=strlen(userdefined)+1;
+  vec = (SVECTOR *)my_malloc(sizeof(SVECTOR)+sizeof(WORD)*(fnum+1)+length);
+  vec->packed=SVECTOR_PACKED;
+  vec->words = (WORD *)(vec+1);
+  vec->words[fnum].wnum=0;
+  vec->words[fnum].weight=0;
+  vec->qwords=NULL;
+  vec->qnum=0;
+  vec->qscale=0;
+  vec->twonorm_sq=0;
+  vec->userdefined = (char *)(vec->words+fnum+1);
+  memcpy(vec->userdefined,userdefined,length);
+  vec->kernel_id=0;
+  vec->next=NULL;
+  vec->factor=factor;
+  return(vec);
+}
+
+SVECTOR *create_svector_quantized(unsigned char *qwords, long qnum, 
+				 double qscale, char *userdefined, 
+				 double factor)
+     /* creates a dense vector with qnum 8 bit values, feature i+1 has
+	the value qwords[i]*qscale */
+{
+  SVECTOR *vec;
+  WORD    empty;
+  long    i;
+
+  empty.wnum=0;
+  empty.weight=0;
+  vec=create_svector(&empty,userdefined,factor);
+  vec->qwords = (unsigned char *)my_malloc(sizeof(unsigned char)*qnum);
+  for(i=0;i<qnum;i++) { 
+      vec->qwords[i]=qwords[i];
+  }
+  vec->qnum=qnum;
+  vec->qscale=qscale;
+  vec->twonorm_sq=sprod_ss(vec,vec);
+  return(vec);
+}
+
 SVECTOR *copy_svector(SVECTOR *vec)
 {
   SVECTOR *newvec=NULL;
-  if(vec) {
+  if(vec && vec->qwords) {
+    newvec=create_svector_quantized(vec->qwords,vec->qnum,vec->qscale,
+				    vec->userdefined,vec->factor);
+    newvec->next=copy_svector(vec->next);
+  }
+  else if(vec) {
     newvec=create_svector(vec->words,vec->userdefined,vec->factor);
     newvec->next=copy_svector(vec->next);
   }
@@ -141,19 +260,47 @@ SVECTOR *copy_svector(SVECTOR *vec)
 void free_svector(SVECTOR *vec)
 {
   if(vec) {
-    free(vec->words);
-    if(vec->userdefined)
-      free(vec->userdefined);
+    /* vectors in the arena of a model are freed with the model */
+    assert(vec->packed != SVECTOR_ARENA);
+    if(vec->packed == SVECTOR_ARENA)
+      return;
+    if(vec->packed == SVECTOR_SEPARATE) {
+      free(vec->words);
+      if(vec->userdefined)
+	free(vec->userdefined);
+    }
+    if(vec->qwords)
+      free(vec->qwords);
     free_svector(vec->next);
     free(vec);
   }
 }
 
+static double sprod_qs(SVECTOR *a, SVECTOR *b) 
+     /* compute the inner product of a quantized and any other vector */
+{
+    register double sum=0;
+    register long i,n;
+    register WORD *bj;
+    if(b->qwords) {
+      register long isum=0;
+      n=minl(a->qnum,b->qnum);
+      for(i=0;i<n;i++) 
+	isum+=(long)a->qwords[i]*b->qwords[i];
+      return((double)isum*a->qscale*b->qscale);
+    }
+    for(bj=b->words;bj->wnum && bj->wnum<=a->qnum;bj++) 
+      sum+=a->qwords[bj->wnum-1]*(bj->weight);
+    return(sum*a->qscale);
+}
+
 double sprod_ss(SVECTOR *a, SVECTOR *b) 
      /* compute the inner product of two sparse vectors */
 {
     register double sum=0;
     register WORD *ai,*bj;
+    if(a->qwords) return(sprod_qs(a,b));
+    if(b->qwords) return(sprod_qs(b,a));
     ai=a->words;
     bj=b->words;
     while (ai->wnum && bj->wnum) {
@@ -458,6 +605,13 @@ void clear_vector_n(double *vec, long n)
 void add_vector_ns(double *vec_n, SVECTOR *vec_s, double faktor)
 {
   register WORD *ai;
+  register long i;
+  if(vec_s->qwords) {
+    faktor*=vec_s->qscale;
+    for(i=0;i<vec_s->qnum;i++) 
+      vec_n[i+1]+=(faktor*vec_s->qwords[i]);
+    return;
+  }
   ai=vec_s->words;
   while (ai->wnum) {
     vec_n[ai->wnum]+=(faktor*ai->weight);
@@ -469,6 +623,12 @@ double sprod_ns(double *vec_n, SVECTOR *vec_s)
 {
   register double sum=0;
   register WORD *ai;
+  register long i;
+  if(vec_s->qwords) {
+    for(i=0;i<vec_s->qnum;i++) 
+      sum+=(vec_n[i+1]*vec_s->qwords[i]);
+    return(sum*vec_s->qscale);
+  }
   ai=vec_s->words;
   while (ai->wnum) {
     sum+=(vec_n[ai->wnum]*ai->weight);
@@ -508,6 +668,9 @@ DOC *create_example(long docnum, long queryid, long slackid,
 void free_example(DOC *example, long deep)
 {
   if(example) {
+    /* the DOCs of a copied model share the arena of their vectors */
+    if(example->fvec && (example->fvec->packed == SVECTOR_ARENA))
+      return;
     if(deep) {
       if(example->fvec)
 	free_svector(example->fvec);
@@ -522,7 +685,7 @@ void write_model(char *modelfile, MODEL *model)
   long j,i,sv_num;
   SVECTOR *v;
 
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("Writing model file..."); fflush(stdout);
   }
   if ((modelfl = fopen (modelfile, "w")) == NULL)
@@ -558,6 +721,10 @@ void write_model(char *modelfile, MODEL *model)
 		(long)(v->words[j]).wnum,
 		(double)(v->words[j]).weight);
       }
+      for (j=0; v->qwords && (j<v->qnum); j++) {
+	if(v->qwords[j])
+	  fprintf(modelfl,"%ld:%.8g ",j+1,(double)(FVAL)(v->qwords[j]*v->qscale));
+      }
       fprintf(modelfl,"#%s\n",v->userdefined);
     /* NOTE: this could be made more efficient by summing the
        alpha's of identical vectors before writing them to the
@@ -565,7 +732,7 @@ void write_model(char *modelfile, MODEL *model)
     }
   }
   fclose(modelfl);
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("done\n");
   }
 }
@@ -582,7 +749,7 @@ MODEL *read_model(char *modelfile)
   char version_buffer[100];
   MODEL *model;
 
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("Reading model..."); fflush(stdout);
   }
 
@@ -618,6 +785,7 @@ MODEL *read_model(char *modelfile)
   model->alpha = (double *)my_malloc(sizeof(double)*model->sv_num);
   model->index=NULL;
   model->lin_weights=NULL;
+  model->arena=NULL;
 
   for(i=1;i<model->sv_num;i++) {
     fgets(line,(int)ll,modelfl);
@@ -635,16 +803,24 @@ MODEL *read_model(char *modelfile)
   fclose(modelfl);
   free(line);
   free(words);
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     fprintf(stdout, "OK. (%d support vectors read)\n",(int)(model->sv_num-1));
   }
   return(model);
 }
 
 MODEL *copy_model(MODEL *model)
+     /* The support vectors of the copy are placed in one allocation
+	(newmodel->arena): first the DOCs, then the SVECTORs, their
+	words and at last the 8 bit values and userdefined strings. */
 {
-  MODEL *newmodel;
-  long  i;
+  MODEL   *newmodel;
+  long    i,fnum;
+  size_t  docs_size,vecs_size,words_size,bytes_size,length;
+  SVECTOR *f,*vec,**next;
+  DOC     *doc;
+  WORD    *words;
+  char    *bytes;
 
   newmodel=(MODEL *)my_malloc(sizeof(MODEL));
   (*newmodel)=(*model);
@@ -653,12 +829,54 @@ MODEL *copy_model(MODEL *model)
   newmodel->index = NULL; /* index is not copied */
   newmodel->supvec[0] = NULL;
   newmodel->alpha[0] = 0;
+
+  docs_size=vecs_size=words_size=bytes_size=0;
+  for(i=1;i<model->sv_num;i++) {
+    docs_size+=sizeof(DOC);
+    for(f=model->supvec[i]->fvec;f;f=f->next) {
+      for(fnum=0;f->words[fnum].wnum;fnum++);
+      vecs_size+=sizeof(SVECTOR);
+      words_size+=sizeof(WORD)*(fnum+1);
+      bytes_size+=f->qnum+strlen(f->userdefined)+1;
+    }
+  }
+  newmodel->arena=(char *)my_malloc(docs_size+vecs_size+words_size+bytes_size+1);
+  doc=(DOC *)newmodel->arena;
+  vec=(SVECTOR *)(newmodel->arena+docs_size);
+  words=(WORD *)(newmodel->arena+docs_size+vecs_size);
+  bytes=newmodel->arena+docs_size+vecs_size+words_size;
+
   for(i=1;i<model->sv_num;i++) {
     newmodel->alpha[i]=model->alpha[i];
-    newmodel->supvec[i]=create_example(model->supvec[i]->docnum,
-				       model->supvec[i]->queryid,0,
-				       model->supvec[i]->costfactor,
-				       copy_svector(model->supvec[i]->fvec));
+    doc->docnum=model->supvec[i]->docnum;
+    doc->queryid=model->supvec[i]->queryid;
+    doc->slackid=0;
+    doc->costfactor=model->supvec[i]->costfactor;
+    next=&doc->fvec;
+    for(f=model->supvec[i]->fvec;f;f=f->next) {
+      (*vec)=(*f);
+      vec->packed=SVECTOR_ARENA; /* freed with the arena by free_model */
+      vec->words=words;
+      for(fnum=0;f->words[fnum].wnum;fnum++)
+	words[fnum]=f->words[fnum];
+      words[fnum]=f->words[fnum];
+      words+=fnum+1;
+      if(f->qwords) {
+	vec->qwords=(unsigned char *)bytes;
+	memcpy(bytes,f->qwords,f->qnum);
+	bytes+=f->qnum;
+      }
+      length=strlen(f->userdefined)+1;
+      vec->userdefined=bytes;
+      memcpy(bytes,f->userdefined,length);
+      bytes+=length;
+      vec->next=NULL;
+      (*next)=vec;
+      next=&vec->next;
+      vec++;
+    }
+    (*next)=NULL;
+    newmodel->supvec[i]=doc++;
   }
   if(model->lin_weights) {
     newmodel->lin_weights = (double *)my_malloc(sizeof(double)*(model->totwords+1));
@@ -673,7 +891,10 @@ void free_model(MODEL *model, int deep)
   long i;
 
   if(model->supvec) {
-    if(deep) {
+    if(deep && model->arena) {
+      free(model->arena);
+    }
+    else if(deep) {
       for(i=1;i<model->sv_num;i++) {
 	free_example(model->supvec[i],1);
       }
@@ -697,14 +918,14 @@ void read_documents(char *docfile, DOC ***docs, double **label,
   double doc_label,costfactor;
   FILE *docfl;
 
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("Scanning examples..."); fflush(stdout);
   }
   nol_ll(docfile,&max_docs,&max_words_doc,&ll); /* scan size of input file */
   max_words_doc+=2;
   ll+=2;
   max_docs+=2;
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("done\n"); fflush(stdout);
   }
 
@@ -716,7 +937,7 @@ void read_documents(char *docfile, DOC ***docs, double **label,
   { perror (docfile); exit (1); }
 
   words = (WORD *)my_malloc(sizeof(WORD)*(max_words_doc+10));
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("Reading examples into memory..."); fflush(stdout);
   }
   dnum=0;
@@ -744,7 +965,7 @@ void read_documents(char *docfile, DOC ***docs, double **label,
 				   create_svector(words,comment,1.0));
     /* printf("\nNorm=%f\n",((*docs)[dnum]->fvec)->twonorm_sq);  */
     dnum++;  
-    if(verbosity>=1) {
+    if(svm_context()->verbosity>=1) {
       if((dnum % 100) == 0) {
 	printf("%ld..",dnum); fflush(stdout);
       }
@@ -754,7 +975,7 @@ void read_documents(char *docfile, DOC ***docs, double **label,
   fclose(docfl);
   free(line);
   free(words);
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     fprintf(stdout, "OK. (%ld examples read)\n", dnum);
   }
   (*totdoc)=dnum;
@@ -869,7 +1090,7 @@ double *read_alphas(char *alphafile,long totdoc)
   { perror (alphafile); exit (1); }
 
   alpha = (double *)my_malloc(sizeof(double)*totdoc);
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("Reading alphas..."); fflush(stdout);
   }
   dnum=0;
@@ -880,7 +1101,7 @@ double *read_alphas(char *alphafile,long totdoc)
   { perror ("\nNot enough values in alpha file!"); exit (1); }
   fclose(fl);
 
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("done\n"); fflush(stdout);
   }
 
@@ -942,9 +1163,15 @@ long maxl(long a, long b)
 
 long get_runtime(void)
 {
+#ifdef _OPENMP
+  /* wall clock, the cpu time of clock() would add up the threads of
+     the parallel loops in svm_learn.c */
+  return((long)(omp_get_wtime()*100.0));
+#else
   clock_t start;
   start = clock();
   return((long)((double)start*100.0/(double)CLOCKS_PER_SEC));
+#endif
 }
 
 int space_or_null(int c) {
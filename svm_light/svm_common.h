@@ -86,8 +86,31 @@ typedef struct svector {
 				  NULL. */
   double  factor;              /* Factor by which this feature vector
 				  is multiplied in the sum. */
+  unsigned char *qwords;       /* If not NULL, the vector is stored dense
+				  and quantized to 8 bit: feature i+1 has
+				  the value qwords[i]*qscale (words is
+				  empty then). Only supported by the
+				  functions used for learning and
+				  classification (sprod_ss, sprod_ns,
+				  add_vector_ns, copy_svector,
+				  free_svector and write_model). */
+  long    qnum;                /* number of values in qwords */
+  double  qscale;              /* step of the quantization */
+  long    packed;              /* SVECTOR_SEPARATE if words and
+				  userdefined are allocated on their
+				  own, SVECTOR_PACKED if they are part
+				  of the allocation of the vector
+				  itself (see alloc_svector),
+				  SVECTOR_ARENA if the vector and
+				  everything it points to live in the
+				  arena of a model (see copy_model)
+				  and are only freed by free_model */
 } SVECTOR;
 
+# define SVECTOR_SEPARATE 0
+# define SVECTOR_PACKED   1
+# define SVECTOR_ARENA    2
+
 typedef struct doc {
   long    docnum;              /* Document ID. This has to be the position of 
                                   the document in the training set array. */
@@ -208,6 +231,12 @@ typedef struct model {
 						 folding */
   double  maxdiff;                            /* precision, up to which this 
 						 model is accurate */
+  char    *arena;                             /* if not NULL, the support
+						 vectors (DOCs, SVECTORs,
+						 words and userdefined)
+						 are placed in this single
+						 allocation (see
+						 copy_model) */
 } MODEL;
 
 typedef struct quadratic_program {
@@ -262,6 +291,8 @@ double kernel(KERNEL_PARM *, DOC *, DOC *);
 double single_kernel(KERNEL_PARM *, SVECTOR *, SVECTOR *); 
 double custom_kernel(KERNEL_PARM *, SVECTOR *, SVECTOR *); 
 SVECTOR *create_svector(WORD *, char *, double);
+SVECTOR *create_svector_quantized(unsigned char *, long, double, char *, double);
+SVECTOR *alloc_svector(long, char *, double);
 SVECTOR *copy_svector(SVECTOR *);
 void   free_svector(SVECTOR *);
 double    sprod_ss(SVECTOR *, SVECTOR *);
@@ -292,8 +323,37 @@ int    space_or_null(int);
 void   *my_malloc(size_t); 
 void   copyright_notice(void);
 
-extern long   verbosity;              /* verbosity level (0-4) */
-extern long   kernel_cache_statistic;
+/* the state svm_light used to keep in globals. every thread has a context
+   (initialized with init_context on first use), svm_learn_classification
+   can be given its own one so several models can be trained concurrently */
+# define DEF_PRECISION          1E-5    /* defaults of the hideo solver */
+# define DEF_MAX_ITERATIONS     200
+# define DEF_LINDEP_SENSITIVITY 1E-8
+
+typedef struct svm_context {
+  long   verbosity;              /* verbosity level (0-4) */
+  long   kernel_cache_statistic;
+
+  /* state of the hideo qp solver (svm_hideo.c) */
+  double *primal,*dual;
+  long   precision_violations;
+  double opt_precision;
+  long   maxiter;
+  double lindep_sensitivity;
+  double *buffer;
+  long   *nonoptimal;
+  long   smallroundcount;
+  long   roundnumber;
+
+  /* transduction (incorporate_unlabeled_examples) */
+  double switchsens,switchsensorg;
+  long   switchnum;
+} SVM_CONTEXT;
+
+void   init_context(SVM_CONTEXT *);
+void   cleanup_context(SVM_CONTEXT *);
+SVM_CONTEXT *svm_context(void);             /* context of the calling thread */
+SVM_CONTEXT *set_svm_context(SVM_CONTEXT *); /* returns the previous one */
 
 # ifdef _MSC_VER
 #  if _MSC_VER < 1900
@@ -29,10 +29,6 @@
   The linear constraint vector ce can only have -1/+1 as entries 
 */
 
-/* Common Block Declarations */
-
-long verbosity;
-
 # define PRIMAL_OPTIMAL      1
 # define DUAL_OPTIMAL        2
 # define MAXITER_EXCEEDED    3
@@ -44,23 +40,11 @@ long verbosity;
 
 /* /////////////////////////////////////////////////////////////// */
 
-# define DEF_PRECISION          1E-5
-# define DEF_MAX_ITERATIONS     200
-# define DEF_LINDEP_SENSITIVITY 1E-8
 # define EPSILON_HIDEO          1E-20
 # define EPSILON_EQ             1E-5
 
+/* the solver state (primal, dual, buffer, ...) is kept in the svm_context */
 double *optimize_qp(QP *, double *, long, double *, LEARN_PARM *);
-double *primal=0,*dual=0;
-long   precision_violations=0;
-double opt_precision=DEF_PRECISION;
-long   maxiter=DEF_MAX_ITERATIONS;
-double lindep_sensitivity=DEF_LINDEP_SENSITIVITY;
-double *buffer;
-long   *nonoptimal;
-
-long  smallroundcount=0;
-long  roundnumber=0;
 
 /* /////////////////////////////////////////////////////////////// */
 
@@ -99,23 +83,24 @@ LEARN_PARM *learn_parm;
   long i,j;
   int result;
   double eq,progress;
+  SVM_CONTEXT *ctx=svm_context();
 
-  roundnumber++;
+  ctx->roundnumber++;
 
-  if(!primal) { /* allocate memory at first call */
-    primal=(double *)my_malloc(sizeof(double)*nx);
-    dual=(double *)my_malloc(sizeof(double)*((nx+1)*2));
-    nonoptimal=(long *)my_malloc(sizeof(long)*(nx));
-    buffer=(double *)my_malloc(sizeof(double)*((nx+1)*2*(nx+1)*2+
+  if(!ctx->primal) { /* allocate memory at first call */
+    ctx->primal=(double *)my_malloc(sizeof(double)*nx);
+    ctx->dual=(double *)my_malloc(sizeof(double)*((nx+1)*2));
+    ctx->nonoptimal=(long *)my_malloc(sizeof(long)*(nx));
+    ctx->buffer=(double *)my_malloc(sizeof(double)*((nx+1)*2*(nx+1)*2+
 					       nx*nx+2*(nx+1)*2+2*nx+1+2*nx+
 					       nx+nx+nx*nx));
     (*threshold)=0;
     for(i=0;i<nx;i++) {
-      primal[i]=0;
+      ctx->primal[i]=0;
     }
   }
 
-  if(verbosity>=4) { /* really verbose */
+  if(ctx->verbosity>=4) { /* really verbose */
     printf("\n\n");
     eq=qp->opt_ce0[0];
     for(i=0;i<qp->opt_n;i++) {
@@ -137,15 +122,15 @@ LEARN_PARM *learn_parm;
   }
 
   result=optimize_hildreth_despo(qp->opt_n,qp->opt_m,
-				 opt_precision,(*epsilon_crit),
-				 learn_parm->epsilon_a,maxiter,
+				 ctx->opt_precision,(*epsilon_crit),
+				 learn_parm->epsilon_a,ctx->maxiter,
 				 /* (long)PRIMAL_OPTIMAL, */
 				 (long)0, (long)0,
-				 lindep_sensitivity,
+				 ctx->lindep_sensitivity,
 				 qp->opt_g,qp->opt_g0,qp->opt_ce,qp->opt_ce0,
-				 qp->opt_low,qp->opt_up,primal,qp->opt_xinit,
-				 dual,nonoptimal,buffer,&progress);
-  if(verbosity>=3) { 
+				 qp->opt_low,qp->opt_up,ctx->primal,qp->opt_xinit,
+				 ctx->dual,ctx->nonoptimal,ctx->buffer,&progress);
+  if(ctx->verbosity>=3) { 
     printf("return(%d)...",result);
   }
 
@@ -155,81 +140,81 @@ LEARN_PARM *learn_parm;
   }
 
   if(result == NAN_SOLUTION) {
-    lindep_sensitivity*=2;  /* throw out linear dependent examples more */
+    ctx->lindep_sensitivity*=2;  /* throw out linear dependent examples more */
                             /* generously */
     if(learn_parm->svm_maxqpsize>2) {
       learn_parm->svm_maxqpsize--;  /* decrease size of qp-subproblems */
     }
-    precision_violations++;
+    ctx->precision_violations++;
   }
 
   /* take one round of only two variable to get unstuck */
-  if((result != PRIMAL_OPTIMAL) || (!(roundnumber % 31)) || (progress <= 0)) {
+  if((result != PRIMAL_OPTIMAL) || (!(ctx->roundnumber % 31)) || (progress <= 0)) {
 
-    smallroundcount++;
+    ctx->smallroundcount++;
 
     result=optimize_hildreth_despo(qp->opt_n,qp->opt_m,
-				   opt_precision,(*epsilon_crit),
-				   learn_parm->epsilon_a,(long)maxiter,
+				   ctx->opt_precision,(*epsilon_crit),
+				   learn_parm->epsilon_a,(long)ctx->maxiter,
 				   (long)PRIMAL_OPTIMAL,(long)SMALLROUND,
-				   lindep_sensitivity,
+				   ctx->lindep_sensitivity,
 				   qp->opt_g,qp->opt_g0,qp->opt_ce,qp->opt_ce0,
-				   qp->opt_low,qp->opt_up,primal,qp->opt_xinit,
-				   dual,nonoptimal,buffer,&progress);
-    if(verbosity>=3) { 
+				   qp->opt_low,qp->opt_up,ctx->primal,qp->opt_xinit,
+				   ctx->dual,ctx->nonoptimal,ctx->buffer,&progress);
+    if(ctx->verbosity>=3) { 
       printf("return_srd(%d)...",result);
     }
 
     if(result != PRIMAL_OPTIMAL) {
       if(result != ONLY_ONE_VARIABLE) 
-	precision_violations++;
+	ctx->precision_violations++;
       if(result == MAXITER_EXCEEDED) 
-	maxiter+=100;
+	ctx->maxiter+=100;
       if(result == NAN_SOLUTION) {
-	lindep_sensitivity*=2;  /* throw out linear dependent examples more */
+	ctx->lindep_sensitivity*=2;  /* throw out linear dependent examples more */
 	                        /* generously */
 	/* results not valid, so return inital values */
 	for(i=0;i<qp->opt_n;i++) {
-	  primal[i]=qp->opt_xinit[i];
+	  ctx->primal[i]=qp->opt_xinit[i];
 	}
       }
     }
   }
 
 
-  if(precision_violations > 50) {
-    precision_violations=0;
+  if(ctx->precision_violations > 50) {
+    ctx->precision_violations=0;
     (*epsilon_crit)*=10.0; 
-    if(verbosity>=1) {
+    if(ctx->verbosity>=1) {
       printf("\nWARNING: Relaxing epsilon on KT-Conditions (%f).\n",
 	     (*epsilon_crit));
     }
   }	  
 
-  if((qp->opt_m>0) && (result != NAN_SOLUTION) && (!isnan(dual[1]-dual[0])))
-    (*threshold)=dual[1]-dual[0];
+  if((qp->opt_m>0) && (result != NAN_SOLUTION) && (!isnan(ctx->dual[1]-ctx->dual[0])))
+    (*threshold)=ctx->dual[1]-ctx->dual[0];
   else
     (*threshold)=0;
 
-  if(verbosity>=4) { /* really verbose */
+  if(ctx->verbosity>=4) { /* really verbose */
     printf("\n\n");
     eq=qp->opt_ce0[0];
     for(i=0;i<qp->opt_n;i++) {
-      eq+=primal[i]*qp->opt_ce[i];
+      eq+=ctx->primal[i]*qp->opt_ce[i];
       printf("%f: ",qp->opt_g0[i]);
       for(j=0;j<qp->opt_n;j++) {
 	printf("%f ",qp->opt_g[i*qp->opt_n+j]);
       }
-      printf(": a=%.30f",primal[i]);
-      printf(": nonopti=%ld",nonoptimal[i]);
+      printf(": a=%.30f",ctx->primal[i]);
+      printf(": nonopti=%ld",ctx->nonoptimal[i]);
       printf(": y=%f\n",qp->opt_ce[i]);
     }
     printf("eq-constraint=%.30f\n",eq);
     printf("b=%f\n",(*threshold));
-    printf(" smallroundcount=%ld ",smallroundcount);
+    printf(" smallroundcount=%ld ",ctx->smallroundcount);
   }
 
-  return(primal);
+  return(ctx->primal);
 }
 
 
@@ -518,8 +503,8 @@ int optimize_hildreth_despo(n,m,precision,epsilon_crit,epsilon_a,maxiter,goal,
       lin_dependent[1]=0;
     }
     else {    /* for unbiased hyperplane, pick only one variable */
-      lin_dependent[0]=smallroundcount % 2;
-      lin_dependent[1]=(smallroundcount+1) % 2;
+      lin_dependent[0]=svm_context()->smallroundcount % 2;
+      lin_dependent[1]=(svm_context()->smallroundcount+1) % 2;
     }
   }
   else {
@@ -593,7 +578,7 @@ int optimize_hildreth_despo(n,m,precision,epsilon_crit,epsilon_a,maxiter,goal,
     }
   }
 
-  if(verbosity>=3) {
+  if(svm_context()->verbosity>=3) {
     printf("real_qp_size(%ld)...",n_indep);
   }
   
@@ -629,7 +614,7 @@ int optimize_hildreth_despo(n,m,precision,epsilon_crit,epsilon_a,maxiter,goal,
   obj_before=calculate_qp_objective(n,g,g0,init);
   obj_after=calculate_qp_objective(n,g,g0,primal);
   (*progress)=obj_before-obj_after;
-  if(verbosity>=3) {
+  if(svm_context()->verbosity>=3) {
     printf("before(%.30f)...after(%.30f)...result_sd(%d)...",
 	   obj_before,obj_after,result); 
   }
@@ -24,6 +24,21 @@
 /* interface to QP-solver */
 double *optimize_qp(QP *, double *, long, double *, LEARN_PARM *);
 
+/* The per-document loops (lin updates, optimality and shrinking
+   checks) run in parallel once this many documents are active. Every
+   document is updated by exactly one thread and the reductions (max,
+   integer counts) do not depend on the order, so the solver output is
+   identical to the sequential one. The threads never call
+   svm_context(), it is thread-local. */
+#define PARALLEL_MIN_DOCS 2000
+
+static long count_index(long int *index)
+{
+  long n;
+  for(n=0;index[n]>=0;n++);
+  return(n);
+}
+
 /*---------------------------------------------------------------------------*/
 
 /* Learns an SVM classification model based on the training data in
@@ -36,7 +51,8 @@ void svm_learn_classification(DOC **docs, double *class, long int
 			      KERNEL_PARM *kernel_parm, 
 			      KERNEL_CACHE *kernel_cache, 
 			      MODEL *model,
-			      double *alpha)
+			      double *alpha,
+			      SVM_CONTEXT *context)
      /* docs:        Training vectors (x-part) */
      /* class:       Training labels (y-part, zero if test example for
                      transduction) */
@@ -50,6 +66,8 @@ void svm_learn_classification(DOC **docs, double *class, long int
      /* alpha:       Start values for the alpha variables or NULL
 	             pointer. The new alpha values are returned after 
 		     optimization if not NULL. Array must be of size totdoc. */
+     /* context:     State of this training (verbosity, solver buffers)
+                     or NULL for the context of the calling thread. */
 {
   long *inconsistent,i,*label;
   long inconsistentnum;
@@ -71,6 +89,10 @@ void svm_learn_classification(DOC **docs, double *class, long int
   double *a_fullset;  /* buffer for storing alpha on full sample in loo */
   TIMING timing_profile;
   SHRINK_STATE shrink_state;
+  SVM_CONTEXT *previous_context;
+
+  /* all functions called from here use the context of this training */
+  previous_context=set_svm_context(context ? context : svm_context());
 
   runtime_start=get_runtime();
   timing_profile.time_kernel=0;
@@ -80,7 +102,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
   timing_profile.time_model=0;
   timing_profile.time_check=0;
   timing_profile.time_select=0;
-  kernel_cache_statistic=0;
+  svm_context()->kernel_cache_statistic=0;
 
   learn_parm->totwords=totwords;
 
@@ -102,6 +124,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
   lin = (double *)my_malloc(sizeof(double)*totdoc);
   learn_parm->svm_cost = (double *)my_malloc(sizeof(double)*totdoc);
   model->supvec = (DOC **)my_malloc(sizeof(DOC *)*(totdoc+2));
+  model->arena=NULL;
   model->alpha = (double *)my_malloc(sizeof(double)*(totdoc+2));
   model->index = (long *)my_malloc(sizeof(long)*(totdoc+2));
 
@@ -129,7 +152,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
   r_delta_avg=estimate_r_delta_average(docs,totdoc,kernel_parm);
   if(learn_parm->svm_c == 0.0) {  /* default value for C */
     learn_parm->svm_c=1.0/(r_delta_avg*r_delta_avg);
-    if(verbosity>=1) 
+    if(svm_context()->verbosity>=1) 
       printf("Setting default regularization parameter C=%.4f\n",
 	     learn_parm->svm_c);
   }
@@ -164,7 +187,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
       learn_parm->svm_cost[i]=0;
     }
   }
-  if(verbosity>=2) {
+  if(svm_context()->verbosity>=2) {
     printf("%ld positive, %ld negative, and %ld unlabeled examples.\n",trainpos,trainneg,totdoc-trainpos-trainneg); fflush(stdout);
   }
 
@@ -175,7 +198,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
 
   /* compute starting state for initial alpha values */
   if(alpha) {
-    if(verbosity>=1) {
+    if(svm_context()->verbosity>=1) {
       printf("Computing starting state..."); fflush(stdout);
     }
     index = (long *)my_malloc(sizeof(long)*totdoc);
@@ -211,20 +234,20 @@ void svm_learn_classification(DOC **docs, double *class, long int
     free(index2dnum);
     free(weights);
     free(aicache);
-    if(verbosity>=1) {
+    if(svm_context()->verbosity>=1) {
       printf("done.\n");  fflush(stdout);
     }   
   } 
 
   if(transduction) {
     learn_parm->svm_iter_to_shrink=99999999;
-    if(verbosity >= 1)
+    if(svm_context()->verbosity >= 1)
       printf("\nDeactivating Shrinking due to an incompatibility with the transductive \nlearner in the current version.\n\n");
   }
 
   if(transduction && learn_parm->compute_loo) {
     learn_parm->compute_loo=0;
-    if(verbosity >= 1)
+    if(svm_context()->verbosity >= 1)
       printf("\nCannot compute leave-one-out estimates for transductive learner.\n\n");
   }    
 
@@ -239,7 +262,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
   }    
 
 
-  if(verbosity==1) {
+  if(svm_context()->verbosity==1) {
     printf("Optimizing"); fflush(stdout);
   }
 
@@ -251,8 +274,8 @@ void svm_learn_classification(DOC **docs, double *class, long int
 				     &maxdiff,(long)-1,
 				     (long)1);
   
-  if(verbosity>=1) {
-    if(verbosity==1) printf("done. (%ld iterations)\n",iterations);
+  if(svm_context()->verbosity>=1) {
+    if(svm_context()->verbosity==1) printf("done. (%ld iterations)\n",iterations);
 
     misclassified=0;
     for(i=0;(i<totdoc);i++) { /* get final statistic */
@@ -264,7 +287,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
 	   misclassified,maxdiff); 
 
     runtime_end=get_runtime();
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf("Runtime in cpu-seconds: %.2f (%.2f%% for kernel/%.2f%% for optimizer/%.2f%% for final/%.2f%% for update/%.2f%% for model/%.2f%% for check/%.2f%% for select)\n",
         ((float)runtime_end-(float)runtime_start)/100.0,
         (100.0*timing_profile.time_kernel)/(float)(runtime_end-runtime_start),
@@ -300,7 +323,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
 	     model->sv_num-1,upsupvecnum);
     }
     
-    if((verbosity>=1) && (!learn_parm->skip_final_opt_check)) {
+    if((svm_context()->verbosity>=1) && (!learn_parm->skip_final_opt_check)) {
       loss=0;
       model_length=0; 
       for(i=0;i<totdoc;i++) {
@@ -319,13 +342,13 @@ void svm_learn_classification(DOC **docs, double *class, long int
 				    kernel_parm));
       if((!learn_parm->remove_inconsistent) && (!transduction)) {
 	runtime_start_xa=get_runtime();
-	if(verbosity>=1) {
+	if(svm_context()->verbosity>=1) {
 	  printf("Computing XiAlpha-estimates..."); fflush(stdout);
 	}
 	compute_xa_estimates(model,label,unlabeled,totdoc,docs,lin,a,
 			     kernel_parm,learn_parm,&(model->xa_error),
 			     &(model->xa_recall),&(model->xa_precision));
-	if(verbosity>=1) {
+	if(svm_context()->verbosity>=1) {
 	  printf("done\n");
 	}
 	printf("Runtime for XiAlpha-estimates in cpu-seconds: %.2f\n",
@@ -342,8 +365,8 @@ void svm_learn_classification(DOC **docs, double *class, long int
 	estimate_transduction_quality(model,label,unlabeled,totdoc,docs,lin);
       }
     }
-    if(verbosity>=1) {
-      printf("Number of kernel evaluations: %ld\n",kernel_cache_statistic);
+    if(svm_context()->verbosity>=1) {
+      printf("Number of kernel evaluations: %ld\n",svm_context()->kernel_cache_statistic);
     }
   }
 
@@ -357,7 +380,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
       if(xi_fullset[i]<0) xi_fullset[i]=0;
       a_fullset[i]=a[i];
     }
-    if(verbosity>=1) {
+    if(svm_context()->verbosity>=1) {
       printf("Computing leave-one-out");
     }
     
@@ -366,7 +389,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
       if(learn_parm->rho*a_fullset[heldout]*r_delta_sq+xi_fullset[heldout]
 	 < 1.0) { 
 	/* guaranteed to not produce a leave-one-out error */
-	if(verbosity==1) {
+	if(svm_context()->verbosity==1) {
 	  printf("+"); fflush(stdout); 
 	}
       }
@@ -374,7 +397,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
 	/* guaranteed to produce a leave-one-out error */
 	loo_count++;
 	if(label[heldout] > 0)  loo_count_pos++; else loo_count_neg++;
-	if(verbosity==1) {
+	if(svm_context()->verbosity==1) {
 	  printf("-"); fflush(stdout); 
 	}
       }
@@ -385,9 +408,9 @@ void svm_learn_classification(DOC **docs, double *class, long int
 	/* make sure heldout example is not currently  */
 	/* shrunk away. Assumes that lin is up to date! */
 	shrink_state.active[heldout]=1;  
-	if(verbosity>=2) 
+	if(svm_context()->verbosity>=2) 
 	  printf("\nLeave-One-Out test on example %ld\n",heldout);
-	if(verbosity>=1) {
+	if(svm_context()->verbosity>=1) {
 	  printf("(?[%ld]",heldout); fflush(stdout); 
 	}
 	
@@ -402,12 +425,12 @@ void svm_learn_classification(DOC **docs, double *class, long int
 	if(((lin[heldout]-model->b)*(double)label[heldout]) <= 0.0) { 
 	  loo_count++;                            /* there was a loo-error */
 	  if(label[heldout] > 0)  loo_count_pos++; else loo_count_neg++;
-	  if(verbosity>=1) {
+	  if(svm_context()->verbosity>=1) {
 	    printf("-)"); fflush(stdout); 
 	  }
 	}
 	else {
-	  if(verbosity>=1) {
+	  if(svm_context()->verbosity>=1) {
 	    printf("+)"); fflush(stdout); 
 	  }
 	}
@@ -417,7 +440,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
     } /* end of leave-one-out loop */
 
 
-    if(verbosity>=1) {
+    if(svm_context()->verbosity>=1) {
       printf("\nRetrain on full problem"); fflush(stdout); 
     }
     optimize_to_convergence(docs,label,totdoc,totwords,learn_parm,
@@ -425,7 +448,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
 			    kernel_cache,&shrink_state,model,inconsistent,unlabeled,
 			    a,lin,c,&timing_profile,
 			    &maxdiff,(long)-1,(long)1);
-    if(verbosity >= 1) 
+    if(svm_context()->verbosity >= 1) 
       printf("done.\n");
     
     
@@ -434,7 +457,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
     model->loo_recall=(1.0-(double)loo_count_pos/(double)trainpos)*100.0;
     model->loo_precision=(trainpos-loo_count_pos)/
       (double)(trainpos-loo_count_pos+loo_count_neg)*100.0;
-    if(verbosity >= 1) {
+    if(svm_context()->verbosity >= 1) {
       fprintf(stdout,"Leave-one-out estimate of the error: error=%.2f%%\n",
 	      model->loo_error);
       fprintf(stdout,"Leave-one-out estimate of the recall: recall=%.2f%%\n",
@@ -461,6 +484,7 @@ void svm_learn_classification(DOC **docs, double *class, long int
   free(xi_fullset);
   free(lin);
   free(learn_parm->svm_cost);
+  set_svm_context(previous_context);
 }
 
 
@@ -529,7 +553,7 @@ void svm_learn_regression(DOC **docs, double *value, long int totdoc,
   timing_profile.time_model=0;
   timing_profile.time_check=0;
   timing_profile.time_select=0;
-  kernel_cache_statistic=0;
+  svm_context()->kernel_cache_statistic=0;
 
   learn_parm->totwords=totwords;
 
@@ -549,6 +573,7 @@ void svm_learn_regression(DOC **docs, double *value, long int totdoc,
   lin = (double *)my_malloc(sizeof(double)*totdoc);
   learn_parm->svm_cost = (double *)my_malloc(sizeof(double)*totdoc);
   model->supvec = (DOC **)my_malloc(sizeof(DOC *)*(totdoc+2));
+  model->arena=NULL;
   model->alpha = (double *)my_malloc(sizeof(double)*(totdoc+2));
   model->index = (long *)my_malloc(sizeof(long)*(totdoc+2));
 
@@ -575,7 +600,7 @@ void svm_learn_regression(DOC **docs, double *value, long int totdoc,
   r_delta_avg=estimate_r_delta_average(docs,totdoc,kernel_parm);
   if(learn_parm->svm_c == 0.0) {  /* default value for C */
     learn_parm->svm_c=1.0/(r_delta_avg*r_delta_avg);
-    if(verbosity>=1) 
+    if(svm_context()->verbosity>=1) 
       printf("Setting default regularization parameter C=%.4f\n",
 	     learn_parm->svm_c);
   }
@@ -599,7 +624,7 @@ void svm_learn_regression(DOC **docs, double *value, long int totdoc,
     printf("WARNING: Using a kernel cache for linear case will slow optimization down!\n");
   } 
 
-  if(verbosity==1) {
+  if(svm_context()->verbosity==1) {
     printf("Optimizing"); fflush(stdout);
   }
 
@@ -610,13 +635,13 @@ void svm_learn_regression(DOC **docs, double *value, long int totdoc,
 				     &timing_profile,&maxdiff,(long)-1,
 				     (long)1);
   
-  if(verbosity>=1) {
-    if(verbosity==1) printf("done. (%ld iterations)\n",iterations);
+  if(svm_context()->verbosity>=1) {
+    if(svm_context()->verbosity==1) printf("done. (%ld iterations)\n",iterations);
 
     printf("Optimization finished (maxdiff=%.5f).\n",maxdiff); 
 
     runtime_end=get_runtime();
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf("Runtime in cpu-seconds: %.2f (%.2f%% for kernel/%.2f%% for optimizer/%.2f%% for final/%.2f%% for update/%.2f%% for model/%.2f%% for check/%.2f%% for select)\n",
         ((float)runtime_end-(float)runtime_start)/100.0,
         (100.0*timing_profile.time_kernel)/(float)(runtime_end-runtime_start),
@@ -652,7 +677,7 @@ void svm_learn_regression(DOC **docs, double *value, long int totdoc,
 	     model->sv_num-1,upsupvecnum);
     }
     
-    if((verbosity>=1) && (!learn_parm->skip_final_opt_check)) {
+    if((svm_context()->verbosity>=1) && (!learn_parm->skip_final_opt_check)) {
       loss=0;
       model_length=0; 
       for(i=0;i<totdoc;i++) {
@@ -667,8 +692,8 @@ void svm_learn_regression(DOC **docs, double *value, long int totdoc,
       fprintf(stdout,"Norm of longest example vector: |x|=%.5f\n",
 	      length_of_longest_document_vector(docs,totdoc,kernel_parm));
     }
-    if(verbosity>=1) {
-      printf("Number of kernel evaluations: %ld\n",kernel_cache_statistic);
+    if(svm_context()->verbosity>=1) {
+      printf("Number of kernel evaluations: %ld\n",svm_context()->kernel_cache_statistic);
     }
   }
     
@@ -794,7 +819,7 @@ void svm_learn_ranking(DOC **docs, double *rankvalue, long int totdoc,
   learn_parm->biased_hyperplane=0;
   pairmodel=(MODEL *)my_malloc(sizeof(MODEL));
   svm_learn_classification(docdiff,target,totpair,totwords,learn_parm,
-			   kernel_parm,(*kernel_cache),pairmodel,NULL);
+			   kernel_parm,(*kernel_cache),pairmodel,NULL,NULL);
 
   /* Transfer the result into a more compact model. If you would like
      to output the original model on pairs of documents, see below. */
@@ -807,6 +832,7 @@ void svm_learn_ranking(DOC **docs, double *rankvalue, long int totdoc,
     alpha[greater[(pairmodel->supvec[i])->docnum]]+=pairmodel->alpha[i];
   }
   model->supvec = (DOC **)my_malloc(sizeof(DOC *)*(totdoc+2));
+  model->arena=NULL;
   model->alpha = (double *)my_malloc(sizeof(double)*(totdoc+2));
   model->index = (long *)my_malloc(sizeof(long)*(totdoc+2));
   model->supvec[0]=0;  /* element 0 reserved and empty for now */
@@ -900,7 +926,7 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
   timing_profile.time_model=0;
   timing_profile.time_check=0;
   timing_profile.time_select=0;
-  kernel_cache_statistic=0;
+  svm_context()->kernel_cache_statistic=0;
 
   learn_parm->totwords=totwords;
 
@@ -920,6 +946,7 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
   lin = (double *)my_malloc(sizeof(double)*totdoc);
   learn_parm->svm_cost = (double *)my_malloc(sizeof(double)*totdoc);
   model->supvec = (DOC **)my_malloc(sizeof(DOC *)*(totdoc+2));
+  model->arena=NULL;
   model->alpha = (double *)my_malloc(sizeof(double)*(totdoc+2));
   model->index = (long *)my_malloc(sizeof(long)*(totdoc+2));
 
@@ -945,7 +972,7 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
   r_delta_avg=estimate_r_delta_average(docs,totdoc,kernel_parm);
   if(learn_parm->svm_c == 0.0) {  /* default value for C */
     learn_parm->svm_c=1.0/(r_delta_avg*r_delta_avg);
-    if(verbosity>=1) 
+    if(svm_context()->verbosity>=1) 
       printf("Setting default regularization parameter C=%.4f\n",
 	     learn_parm->svm_c);
   }
@@ -976,7 +1003,7 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
       
   /* compute starting state for initial alpha values */
   if(alpha) {
-    if(verbosity>=1) {
+    if(svm_context()->verbosity>=1) {
       printf("Computing starting state..."); fflush(stdout);
     }
     index = (long *)my_malloc(sizeof(long)*totdoc);
@@ -1012,7 +1039,7 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
     free(index2dnum);
     free(weights);
     free(aicache);
-    if(verbosity>=1) {
+    if(svm_context()->verbosity>=1) {
       printf("done.\n");  fflush(stdout);
     }   
   } 
@@ -1028,7 +1055,7 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
     kernel_cache = NULL;   
   } 
 
-  if(verbosity==1) {
+  if(svm_context()->verbosity==1) {
     printf("Optimizing"); fflush(stdout);
   }
 
@@ -1047,8 +1074,8 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
 				     a,lin,c,&timing_profile,
 				     &maxdiff,(long)-1,(long)1);
   
-  if(verbosity>=1) {
-    if(verbosity==1) printf("done. (%ld iterations)\n",iterations);
+  if(svm_context()->verbosity>=1) {
+    if(svm_context()->verbosity==1) printf("done. (%ld iterations)\n",iterations);
 
     misclassified=0;
     for(i=0;(i<totdoc);i++) { /* get final statistic */
@@ -1059,7 +1086,7 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
     printf("Optimization finished (maxdiff=%.5f).\n",maxdiff); 
 
     runtime_end=get_runtime();
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf("Runtime in cpu-seconds: %.2f (%.2f%% for kernel/%.2f%% for optimizer/%.2f%% for final/%.2f%% for update/%.2f%% for model/%.2f%% for check/%.2f%% for select)\n",
         ((float)runtime_end-(float)runtime_start)/100.0,
         (100.0*timing_profile.time_kernel)/(float)(runtime_end-runtime_start),
@@ -1075,7 +1102,7 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
 	     (runtime_end-runtime_start)/100.0);
     }
   }
-  if((verbosity>=1) && (!learn_parm->skip_final_opt_check)) {
+  if((svm_context()->verbosity>=1) && (!learn_parm->skip_final_opt_check)) {
     loss=0;
     model_length=0; 
     for(i=0;i<totdoc;i++) {
@@ -1121,7 +1148,7 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
     free(alphaslack);
   }
   
-  if((verbosity>=1) && (!learn_parm->skip_final_opt_check)) {
+  if((svm_context()->verbosity>=1) && (!learn_parm->skip_final_opt_check)) {
     if(learn_parm->sharedslack) {
       printf("Number of SV: %ld\n",
 	     model->sv_num-1);
@@ -1145,8 +1172,8 @@ void svm_learn_optimization(DOC **docs, double *rhs, long int
     fprintf(stdout,"Norm of longest example vector: |x|=%.5f\n",
 	    length_of_longest_document_vector(docs,totdoc,kernel_parm));
   }
-  if(verbosity>=1) {
-    printf("Number of kernel evaluations: %ld\n",kernel_cache_statistic);
+  if(svm_context()->verbosity>=1) {
+    printf("Number of kernel evaluations: %ld\n",svm_context()->kernel_cache_statistic);
   }
     
   if(alpha) {
@@ -1280,16 +1307,16 @@ long optimize_to_convergence(DOC **docs, long int *label, long int totdoc,
 
     if(kernel_cache)
       kernel_cache->time=iteration;  /* for lru cache */
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf(
 	"Iteration %ld: ",iteration); fflush(stdout);
     }
-    else if(verbosity==1) {
+    else if(svm_context()->verbosity==1) {
       printf("."); fflush(stdout);
     }
 
-    if(verbosity>=2) t0=get_runtime();
-    if(verbosity>=3) {
+    if(svm_context()->verbosity>=2) t0=get_runtime();
+    if(svm_context()->verbosity>=3) {
       printf("\nSelecting working set... "); fflush(stdout); 
     }
 
@@ -1386,37 +1413,37 @@ long optimize_to_convergence(DOC **docs, long int *label, long int totdoc,
       }
     }
 
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf(" %ld vectors chosen\n",choosenum); fflush(stdout); 
     }
 
-    if(verbosity>=2) t1=get_runtime();
+    if(svm_context()->verbosity>=2) t1=get_runtime();
 
     if(kernel_cache) 
       cache_multiple_kernel_rows(kernel_cache,docs,working2dnum,
 				 choosenum,kernel_parm); 
     
-    if(verbosity>=2) t2=get_runtime();
+    if(svm_context()->verbosity>=2) t2=get_runtime();
     if(retrain != 2) {
       optimize_svm(docs,label,unlabeled,inconsistent,0.0,chosen,active2dnum,
 		   model,totdoc,working2dnum,choosenum,a,lin,c,learn_parm,
 		   aicache,kernel_parm,&qp,&epsilon_crit_org);
     }
 
-    if(verbosity>=2) t3=get_runtime();
+    if(svm_context()->verbosity>=2) t3=get_runtime();
     update_linear_component(docs,label,active2dnum,a,a_old,working2dnum,totdoc,
 			    totwords,kernel_parm,kernel_cache,lin,aicache,
 			    weights);
 
-    if(verbosity>=2) t4=get_runtime();
+    if(svm_context()->verbosity>=2) t4=get_runtime();
     supvecnum=calculate_svm_model(docs,label,unlabeled,lin,a,a_old,c,
 		                  learn_parm,working2dnum,active2dnum,model);
 
-    if(verbosity>=2) t5=get_runtime();
+    if(svm_context()->verbosity>=2) t5=get_runtime();
 
     /* The following computation of the objective function works only */
     /* relative to the active variables */
-    if(verbosity>=3) {
+    if(svm_context()->verbosity>=3) {
       criterion=compute_objective_function(a,lin,c,learn_parm->eps,label,
 		                           active2dnum);
       printf("Objective function (over active variables): %.16f\n",criterion);
@@ -1441,7 +1468,7 @@ long optimize_to_convergence(DOC **docs, long int *label, long int totdoc,
 			     inconsistent,active2dnum,last_suboptimal_at,
 			     iteration,kernel_parm);
 
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       t6=get_runtime();
       timing_profile->time_select+=t1-t0;
       timing_profile->time_kernel+=t2-t1;
@@ -1460,7 +1487,7 @@ long optimize_to_convergence(DOC **docs, long int *label, long int totdoc,
       /* long time no progress? */
       terminate=1;
       retrain=0;
-      if(verbosity>=1) 
+      if(svm_context()->verbosity>=1) 
 	printf("\nWARNING: Relaxing KT-Conditions due to slow progress! Terminating!\n");
     }
 
@@ -1468,9 +1495,9 @@ long optimize_to_convergence(DOC **docs, long int *label, long int totdoc,
     if((!retrain) && (inactivenum>0) 
        && ((!learn_parm->skip_final_opt_check) 
 	   || (kernel_parm->kernel_type == LINEAR))) { 
-      if(((verbosity>=1) && (kernel_parm->kernel_type != LINEAR)) 
-	 || (verbosity>=2)) {
-	if(verbosity==1) {
+      if(((svm_context()->verbosity>=1) && (kernel_parm->kernel_type != LINEAR)) 
+	 || (svm_context()->verbosity>=2)) {
+	if(svm_context()->verbosity==1) {
 	  printf("\n");
 	}
 	printf(" Checking optimality of inactive variables..."); 
@@ -1493,8 +1520,8 @@ long optimize_to_convergence(DOC **docs, long int *label, long int totdoc,
       if((*maxdiff) > learn_parm->epsilon_crit) 
 	retrain=1;
       timing_profile->time_shrink+=get_runtime()-t1;
-      if(((verbosity>=1) && (kernel_parm->kernel_type != LINEAR)) 
-	 || (verbosity>=2)) {
+      if(((svm_context()->verbosity>=1) && (kernel_parm->kernel_type != LINEAR)) 
+	 || (svm_context()->verbosity>=2)) {
 	printf("done.\n");  fflush(stdout);
         printf(" Number of inactive variables = %ld\n",inactivenum);
       }		  
@@ -1510,12 +1537,12 @@ long optimize_to_convergence(DOC **docs, long int *label, long int totdoc,
     if(learn_parm->epsilon_crit<epsilon_crit_org) 
       learn_parm->epsilon_crit=epsilon_crit_org;
     
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf(" => (%ld SV (incl. %ld SV at u-bound), max violation=%.5f)\n",
 	     supvecnum,model->at_upper_bound,(*maxdiff)); 
       fflush(stdout);
     }
-    if(verbosity>=3) {
+    if(svm_context()->verbosity>=3) {
       printf("\n");
     }
 
@@ -1525,7 +1552,7 @@ long optimize_to_convergence(DOC **docs, long int *label, long int totdoc,
       }
       activenum=compute_index(shrink_state->active,totdoc,active2dnum);
       inactivenum=0;
-      if(verbosity==1) printf("done\n");
+      if(svm_context()->verbosity==1) printf("done\n");
       retrain=incorporate_unlabeled_examples(model,label,inconsistent,
 					     unlabeled,a,lin,totdoc,
 					     selcrit,selexam,key,
@@ -1557,7 +1584,7 @@ long optimize_to_convergence(DOC **docs, long int *label, long int totdoc,
     }
 
     if((!retrain) && learn_parm->remove_inconsistent) {
-      if(verbosity>=1) {
+      if(svm_context()->verbosity>=1) {
 	printf(" Moving training errors to inconsistent examples...");
 	fflush(stdout);
       }
@@ -1578,7 +1605,7 @@ long optimize_to_convergence(DOC **docs, long int *label, long int totdoc,
 	  learn_parm->epsilon_crit=2.0;
 	} 
       }
-      if(verbosity>=1) {
+      if(svm_context()->verbosity>=1) {
 	printf("done.\n");
 	if(retrain) {
 	  printf(" Now %ld inconsistent examples.\n",inconsistentnum);
@@ -1730,16 +1757,16 @@ long optimize_to_convergence_sharedslack(DOC **docs, long int *label,
 
     if(kernel_cache)
       kernel_cache->time=iteration;  /* for lru cache */
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf(
 	"Iteration %ld: ",iteration); fflush(stdout);
     }
-    else if(verbosity==1) {
+    else if(svm_context()->verbosity==1) {
       printf("."); fflush(stdout);
     }
 
-    if(verbosity>=2) t0=get_runtime();
-    if(verbosity>=3) {
+    if(svm_context()->verbosity>=2) t0=get_runtime();
+    if(svm_context()->verbosity>=3) {
       printf("\nSelecting working set... "); fflush(stdout); 
     }
 
@@ -1755,7 +1782,7 @@ long optimize_to_convergence_sharedslack(DOC **docs, long int *label,
       if((iteration % 2) 
 	 || (!slackset) || (maxsharedviol<learn_parm->epsilon_crit)){
 	/* do a step with examples from different slack sets */
-	if(verbosity >= 2) {
+	if(svm_context()->verbosity >= 2) {
 	  printf("(i-step)"); fflush(stdout);
 	}
 	i=0;
@@ -1797,7 +1824,7 @@ long optimize_to_convergence_sharedslack(DOC **docs, long int *label,
 			      (long)0,key,chosen);
       }
       else { /* do a step with all examples from same slack set */
-	if(verbosity >= 2) {
+	if(svm_context()->verbosity >= 2) {
 	  printf("(j-step on %ld)",slackset); fflush(stdout);
 	}
 	jointstep=1;
@@ -1838,17 +1865,17 @@ long optimize_to_convergence_sharedslack(DOC **docs, long int *label,
 			      chosen,iteration);
     }
 
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf(" %ld vectors chosen\n",choosenum); fflush(stdout); 
     }
 
-    if(verbosity>=2) t1=get_runtime();
+    if(svm_context()->verbosity>=2) t1=get_runtime();
 
     if(kernel_cache) 
       cache_multiple_kernel_rows(kernel_cache,docs,working2dnum,
 				 choosenum,kernel_parm); 
 
-    if(verbosity>=2) t2=get_runtime();
+    if(svm_context()->verbosity>=2) t2=get_runtime();
     if(jointstep) learn_parm->biased_hyperplane=1;
     optimize_svm(docs,label,unlabeled,ignore,eq_target,chosen,active2dnum,
 		 model,totdoc,working2dnum,choosenum,a,lin,c,learn_parm,
@@ -1874,22 +1901,22 @@ long optimize_to_convergence_sharedslack(DOC **docs, long int *label,
       learn_parm->svm_cost[i]=a[i]+(learn_parm->svm_c
 				    -alphaslack[docs[i]->slackid]);
 
-    if(verbosity>=2) t3=get_runtime();
+    if(svm_context()->verbosity>=2) t3=get_runtime();
     update_linear_component(docs,label,active2dnum,a,a_old,working2dnum,totdoc,
 			    totwords,kernel_parm,kernel_cache,lin,aicache,
 			    weights);
     compute_shared_slacks(docs,label,a,lin,c,active2dnum,learn_parm,
 			  slack,alphaslack);
 
-    if(verbosity>=2) t4=get_runtime();
+    if(svm_context()->verbosity>=2) t4=get_runtime();
     supvecnum=calculate_svm_model(docs,label,unlabeled,lin,a,a_old,c,
 		                  learn_parm,working2dnum,active2dnum,model);
 
-    if(verbosity>=2) t5=get_runtime();
+    if(svm_context()->verbosity>=2) t5=get_runtime();
 
     /* The following computation of the objective function works only */
     /* relative to the active variables */
-    if(verbosity>=3) {
+    if(svm_context()->verbosity>=3) {
       criterion=compute_objective_function(a,lin,c,learn_parm->eps,label,
 		                           active2dnum);
       printf("Objective function (over active variables): %.16f\n",criterion);
@@ -1906,7 +1933,7 @@ long optimize_to_convergence_sharedslack(DOC **docs, long int *label,
 			     active2dnum,last_suboptimal_at,
 			     iteration,kernel_parm);
 
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       t6=get_runtime();
       timing_profile->time_select+=t1-t0;
       timing_profile->time_kernel+=t2-t1;
@@ -1925,7 +1952,7 @@ long optimize_to_convergence_sharedslack(DOC **docs, long int *label,
       /* long time no progress? */
       terminate=1;
       retrain=0;
-      if(verbosity>=1) 
+      if(svm_context()->verbosity>=1) 
 	printf("\nWARNING: Relaxing KT-Conditions due to slow progress! Terminating!\n");
     }
 
@@ -1934,9 +1961,9 @@ long optimize_to_convergence_sharedslack(DOC **docs, long int *label,
     if((!retrain) && (inactivenum>0) 
        && ((!learn_parm->skip_final_opt_check) 
 	   || (kernel_parm->kernel_type == LINEAR))) { 
-      if(((verbosity>=1) && (kernel_parm->kernel_type != LINEAR)) 
-	 || (verbosity>=2)) {
-	if(verbosity==1) {
+      if(((svm_context()->verbosity>=1) && (kernel_parm->kernel_type != LINEAR)) 
+	 || (svm_context()->verbosity>=2)) {
+	if(svm_context()->verbosity==1) {
 	  printf("\n");
 	}
 	printf(" Checking optimality of inactive variables..."); 
@@ -1967,8 +1994,8 @@ long optimize_to_convergence_sharedslack(DOC **docs, long int *label,
       if((*maxdiff) > learn_parm->epsilon_crit) 
 	retrain=1;
       timing_profile->time_shrink+=get_runtime()-t1;
-      if(((verbosity>=1) && (kernel_parm->kernel_type != LINEAR)) 
-	 || (verbosity>=2)) {
+      if(((svm_context()->verbosity>=1) && (kernel_parm->kernel_type != LINEAR)) 
+	 || (svm_context()->verbosity>=2)) {
 	printf("done.\n");  fflush(stdout);
         printf(" Number of inactive variables = %ld\n",inactivenum);
       }		  
@@ -1984,12 +2011,12 @@ long optimize_to_convergence_sharedslack(DOC **docs, long int *label,
     if(learn_parm->epsilon_crit<epsilon_crit_org) 
       learn_parm->epsilon_crit=epsilon_crit_org;
     
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf(" => (%ld SV (incl. %ld SV at u-bound), max violation=%.5f)\n",
 	     supvecnum,model->at_upper_bound,(*maxdiff)); 
       fflush(stdout);
     }
-    if(verbosity>=3) {
+    if(svm_context()->verbosity>=3) {
       printf("\n");
     }
 
@@ -2113,7 +2140,7 @@ void optimize_svm(DOC **docs, long int *label, long int *unlabeled,
 				      varnum,totdoc,learn_parm,aicache,
 				      kernel_parm,qp);
 
-    if(verbosity>=3) {
+    if(svm_context()->verbosity>=3) {
       printf("Running optimizer..."); fflush(stdout);
     }
     /* call the qp-subsolver */
@@ -2123,7 +2150,7 @@ void optimize_svm(DOC **docs, long int *label, long int *unlabeled,
                                    /* the threshold for free. otherwise */
                                    /* b is calculated in calculate_model. */
 		    learn_parm);
-    if(verbosity>=3) {         
+    if(svm_context()->verbosity>=3) {         
       printf("done\n");
     }
 
@@ -2150,7 +2177,7 @@ void compute_matrices_for_optimization(DOC **docs, long int *label,
   register long ki,kj,i,j;
   register double kernel_temp;
 
-  if(verbosity>=3) {
+  if(svm_context()->verbosity>=3) {
     fprintf(stdout,"Computing qp-matrices (type %ld kernel [degree %ld, rbf_gamma %f, coef_lin %f, coef_const %f])...",kernel_parm->kernel_type,kernel_parm->poly_degree,kernel_parm->rbf_gamma,kernel_parm->coef_lin,kernel_parm->coef_const); 
     fflush(stdout);
   }
@@ -2197,7 +2224,7 @@ void compute_matrices_for_optimization(DOC **docs, long int *label,
       qp->opt_g[varnum*j+i]=(double)label[ki]*(double)label[kj]*kernel_temp;
     }
 
-    if(verbosity>=3) {
+    if(svm_context()->verbosity>=3) {
       if(i % 20 == 0) {
 	fprintf(stdout,"%ld..",i); fflush(stdout);
       }
@@ -2211,7 +2238,7 @@ void compute_matrices_for_optimization(DOC **docs, long int *label,
     qp->opt_g0[i]=(learn_parm->eps-(double)label[key[i]]*c[key[i]])+qp->opt_g0[i]*(double)label[key[i]];    
   }
 
-  if(verbosity>=3) {
+  if(svm_context()->verbosity>=3) {
     fprintf(stdout,"done\n");
   }
 }
@@ -2226,7 +2253,7 @@ long calculate_svm_model(DOC **docs, long int *label, long int *unlabeled,
   long i,ii,pos,b_calculated=0,first_low,first_high;
   double ex_c,b_temp,b_low,b_high;
 
-  if(verbosity>=3) {
+  if(svm_context()->verbosity>=3) {
     printf("Calculating model..."); fflush(stdout);
   }
 
@@ -2329,7 +2356,7 @@ long calculate_svm_model(DOC **docs, long int *label, long int *unlabeled,
     }
   }
 
-  if(verbosity>=3) {
+  if(svm_context()->verbosity>=3) {
     printf("done\n"); fflush(stdout);
   }
 
@@ -2345,8 +2372,7 @@ long check_optimality(MODEL *model, long int *label, long int *unlabeled,
 		      long int iteration, KERNEL_PARM *kernel_parm)
      /* Check KT-conditions */
 {
-  long i,ii,retrain;
-  double dist,ex_c,target;
+  long ii,retrain,activenum;
 
   if(kernel_parm->kernel_type == LINEAR) {  /* be optimistic */
     learn_parm->epsilon_shrink=-learn_parm->epsilon_crit+epsilon_crit_org;  
@@ -2357,22 +2383,29 @@ long check_optimality(MODEL *model, long int *label, long int *unlabeled,
   retrain=0;
   (*maxdiff)=0;
   (*misclassified)=0;
-  for(ii=0;(i=active2dnum[ii])>=0;ii++) {
+  activenum=count_index(active2dnum);
+#pragma omp parallel if(activenum >= PARALLEL_MIN_DOCS)
+  {
+  long i,thread_misclassified=0;
+  double dist,ex_c,target,thread_maxdiff=0;
+#pragma omp for schedule(static)
+  for(ii=0;ii<activenum;ii++) {
+    i=active2dnum[ii];
     if((!inconsistent[i]) && label[i]) {
       dist=(lin[i]-model->b)*(double)label[i];/* 'distance' from
 						 hyperplane*/
       target=-(learn_parm->eps-(double)label[i]*c[i]);
       ex_c=learn_parm->svm_cost[i]-learn_parm->epsilon_a;
       if(dist <= 0) {       
-	(*misclassified)++;  /* does not work due to deactivation of var */
+	thread_misclassified++;  /* does not work due to deactivation of var */
       }
       if((a[i]>learn_parm->epsilon_a) && (dist > target)) {
-	if((dist-target)>(*maxdiff))  /* largest violation */
-	  (*maxdiff)=dist-target;
+	if((dist-target)>thread_maxdiff)  /* largest violation */
+	  thread_maxdiff=dist-target;
       }
       else if((a[i]<ex_c) && (dist < target)) {
-	if((target-dist)>(*maxdiff))  /* largest violation */
-	  (*maxdiff)=target-dist;
+	if((target-dist)>thread_maxdiff)  /* largest violation */
+	  thread_maxdiff=target-dist;
       }
       /* Count how long a variable was at lower/upper bound (and optimal).*/
       /* Variables, which were at the bound and optimal for a long */
@@ -2393,6 +2426,13 @@ long check_optimality(MODEL *model, long int *label, long int *unlabeled,
       }
     }   
   }
+#pragma omp critical (svm_check_optimality)
+  {
+  if(thread_maxdiff>(*maxdiff))
+    (*maxdiff)=thread_maxdiff;
+  (*misclassified)+=thread_misclassified;
+  }
+  }
   /* termination criterion */
   if((!retrain) && ((*maxdiff) > learn_parm->epsilon_crit)) {  
     retrain=1;
@@ -2432,15 +2472,15 @@ long check_optimality_sharedslack(DOC **docs, MODEL *model, long int *label,
     if((a[i]>learn_parm->epsilon_a) && (dist > target)) {
       if((dist-target)>(*maxdiff)) {  /* largest violation */
 	(*maxdiff)=dist-target;
-	if(verbosity>=5) printf("sid %ld: dist=%.2f, target=%.2f, slack=%.2f, a=%f, alphaslack=%f\n",docs[i]->slackid,dist,target,slack[docs[i]->slackid],a[i],alphaslack[docs[i]->slackid]);
-	if(verbosity>=5) printf(" (single %f)\n",(*maxdiff));
+	if(svm_context()->verbosity>=5) printf("sid %ld: dist=%.2f, target=%.2f, slack=%.2f, a=%f, alphaslack=%f\n",docs[i]->slackid,dist,target,slack[docs[i]->slackid],a[i],alphaslack[docs[i]->slackid]);
+	if(svm_context()->verbosity>=5) printf(" (single %f)\n",(*maxdiff));
       }
     }
     if((alphaslack[docs[i]->slackid]<ex_c) && (slack[docs[i]->slackid]>0)) {
       if((slack[docs[i]->slackid])>(*maxdiff)) { /* largest violation */
 	(*maxdiff)=slack[docs[i]->slackid];
-	if(verbosity>=5) printf("sid %ld: dist=%.2f, target=%.2f, slack=%.2f, a=%f, alphaslack=%f\n",docs[i]->slackid,dist,target,slack[docs[i]->slackid],a[i],alphaslack[docs[i]->slackid]);
-	if(verbosity>=5) printf(" (joint %f)\n",(*maxdiff));
+	if(svm_context()->verbosity>=5) printf("sid %ld: dist=%.2f, target=%.2f, slack=%.2f, a=%f, alphaslack=%f\n",docs[i]->slackid,dist,target,slack[docs[i]->slackid],a[i],alphaslack[docs[i]->slackid]);
+	if(svm_context()->verbosity>=5) printf(" (joint %f)\n",(*maxdiff));
       }
     }
     /* Count how long a variable was at lower/upper bound (and optimal).*/
@@ -2511,7 +2551,7 @@ long identify_inconsistent(double *a, long int *label,
 	(*inconsistentnum)++;
 	inconsistent[i]=1;  /* never choose again */
 	retrain=2;          /* start over */
-	if(verbosity>=3) {
+	if(svm_context()->verbosity>=3) {
 	  printf("inconsistent(%ld)..",i); fflush(stdout);
 	}
     }
@@ -2539,7 +2579,7 @@ long identify_misclassified(double *lin, long int *label,
 	(*inconsistentnum)++;
 	inconsistent[i]=1;  /* never choose again */
 	retrain=2;          /* start over */
-	if(verbosity>=3) {
+	if(svm_context()->verbosity>=3) {
 	  printf("inconsistent(%ld)..",i); fflush(stdout);
 	}
     }
@@ -2575,7 +2615,7 @@ long identify_one_misclassified(double *lin, long int *label,
     (*inconsistentnum)++;
     inconsistent[maxex]=1;  /* never choose again */
     retrain=2;          /* start over */
-    if(verbosity>=3) {
+    if(svm_context()->verbosity>=3) {
       printf("inconsistent(%ld)..",i); fflush(stdout);
     }
   }
@@ -2596,6 +2636,7 @@ void update_linear_component(DOC **docs, long int *label,
 {
   register long i,ii,j,jj;
   register double tec;
+  long activenum;
   SVECTOR *f;
 
   if(kernel_parm->kernel_type==0) { /* special linear case */
@@ -2607,7 +2648,10 @@ void update_linear_component(DOC **docs, long int *label,
 			f->factor*((a[i]-a_old[i])*(double)label[i]));
       }
     }
-    for(jj=0;(j=active2dnum[jj])>=0;jj++) {
+    activenum=count_index(active2dnum);
+#pragma omp parallel for private(j,f) schedule(static) if(activenum >= PARALLEL_MIN_DOCS)
+    for(jj=0;jj<activenum;jj++) {
+      j=active2dnum[jj];
       for(f=docs[j]->fvec;f;f=f->next)  
 	lin[j]+=f->factor*sprod_ns(weights,f);
     }
@@ -2642,12 +2686,11 @@ long incorporate_unlabeled_examples(MODEL *model, long int *label,
   double dist,model_length,posratio,negratio;
   long check_every=2;
   double loss;
-  static double switchsens=0.0,switchsensorg=0.0;
   double umin,umax,sumalpha;
   long imin=0,imax=0;
-  static long switchnum=0;
+  SVM_CONTEXT *ctx=svm_context();
 
-  switchsens/=1.2;
+  ctx->switchsens/=1.2;
 
   /* assumes that lin[] is up to date -> no inactive vars */
 
@@ -2722,7 +2765,7 @@ long incorporate_unlabeled_examples(MODEL *model, long int *label,
       /*      printf("Ubounded %ld (class %ld, unlabeled %ld)\n",i,label[i],unlabeled[i]); */
     }
   }
-  if(verbosity>=2) {
+  if(svm_context()->verbosity>=2) {
     printf("POS=%ld, ORGPOS=%ld, ORGNEG=%ld\n",pos,orgpos,orgneg);
     printf("POS=%ld, NEWPOS=%ld, NEWNEG=%ld\n",pos,newpos,newneg);
     printf("pos ratio = %f (%f).\n",(double)(upos)/(double)(allunlab),posratio);
@@ -2769,7 +2812,7 @@ long incorporate_unlabeled_examples(MODEL *model, long int *label,
 	}
       }
     }
-    if(verbosity>=1) {
+    if(svm_context()->verbosity>=1) {
       /* printf("costratio %f, costratio_unlab %f, unlabbound %f\n",
 	 learn_parm->svm_costratio,learn_parm->svm_costratio_unlab,
 	 learn_parm->svm_unlabbound); */
@@ -2777,15 +2820,15 @@ long incorporate_unlabeled_examples(MODEL *model, long int *label,
 	     unsupaddnum1,unsupaddnum2); 
       fflush(stdout);
     }
-    if(verbosity >= 1) 
+    if(svm_context()->verbosity >= 1) 
       printf("Retraining.");
-    if(verbosity >= 2) printf("\n");
+    if(svm_context()->verbosity >= 2) printf("\n");
     return((long)3);
   }
   if((transductcycle % check_every) == 0) {
-    if(verbosity >= 1) 
+    if(svm_context()->verbosity >= 1) 
       printf("Retraining.");
-    if(verbosity >= 2) printf("\n");
+    if(svm_context()->verbosity >= 2) printf("\n");
     j1=0;
     j2=0;
     unsupaddnum1=0;
@@ -2817,7 +2860,7 @@ long incorporate_unlabeled_examples(MODEL *model, long int *label,
       }
     }
 
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       /* printf("costratio %f, costratio_unlab %f, unlabbound %f\n",
 	     learn_parm->svm_costratio,learn_parm->svm_costratio_unlab,
 	     learn_parm->svm_unlabbound); */
@@ -2848,7 +2891,7 @@ long incorporate_unlabeled_examples(MODEL *model, long int *label,
       }
     }
     model_length=sqrt(model_length); 
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf("Model-length = %f (%f), loss = %f, objective = %f\n",
 	     model_length,sumalpha,loss,loss+0.5*model_length*model_length);
       fflush(stdout);
@@ -2878,7 +2921,7 @@ long incorporate_unlabeled_examples(MODEL *model, long int *label,
 	  imax=i;
 	}
       }
-      if((umin < (umax+switchsens-1E-4))) {
+      if((umin < (umax+ctx->switchsens-1E-4))) {
 	j1++;
 	j2++;
 	unsupaddnum1++;	
@@ -2904,11 +2947,11 @@ long incorporate_unlabeled_examples(MODEL *model, long int *label,
 	j3++;
       }
     }
-    switchnum+=unsupaddnum1+unsupaddnum2;
+    ctx->switchnum+=unsupaddnum1+unsupaddnum2;
 
     /* stop and print out current margin
-       printf("switchnum %ld %ld\n",switchnum,kernel_parm->poly_degree);
-       if(switchnum == 2*kernel_parm->poly_degree) {
+       printf("switchnum %ld %ld\n",ctx->switchnum,kernel_parm->poly_degree);
+       if(ctx->switchnum == 2*kernel_parm->poly_degree) {
        learn_parm->svm_unlabbound=1;
        }
        */
@@ -2921,27 +2964,27 @@ long incorporate_unlabeled_examples(MODEL *model, long int *label,
 	}
 	write_prediction(learn_parm->predfile,model,lin,a,unlabeled,label,
 			 totdoc,learn_parm);  
-	if(verbosity>=1)
-	  printf("Number of switches: %ld\n",switchnum);
+	if(svm_context()->verbosity>=1)
+	  printf("Number of switches: %ld\n",ctx->switchnum);
 	return((long)0);
       }
-      switchsens=switchsensorg;
+      ctx->switchsens=ctx->switchsensorg;
       learn_parm->svm_unlabbound*=1.5;
       if(learn_parm->svm_unlabbound>1) {
 	learn_parm->svm_unlabbound=1;
       }
       model->at_upper_bound=0; /* since upper bound increased */
-      if(verbosity>=1) 
+      if(svm_context()->verbosity>=1) 
 	printf("Increasing influence of unlabeled examples to %f%% .",
 	       learn_parm->svm_unlabbound*100.0);
     }
-    else if(verbosity>=1) {
+    else if(svm_context()->verbosity>=1) {
       printf("%ld positive -> Switching labels of %ld POS / %ld NEG unlabeled examples.",
 	     upos,unsupaddnum1,unsupaddnum2); 
       fflush(stdout);
     }
 
-    if(verbosity >= 2) printf("\n");
+    if(svm_context()->verbosity >= 2) printf("\n");
     
     learn_parm->epsilon_crit=0.5; /* don't need to be so picky */
 
@@ -3253,11 +3296,11 @@ long shrink_problem(DOC **docs,
   long i,ii,change,activenum,lastiter;
   double *a_old;
   
-  activenum=0;
+  activenum=count_index(active2dnum);
   change=0;
-  for(ii=0;active2dnum[ii]>=0;ii++) {
+#pragma omp parallel for private(i,lastiter) reduction(+:change) schedule(static) if(activenum >= PARALLEL_MIN_DOCS)
+  for(ii=0;ii<activenum;ii++) {
     i=active2dnum[ii];
-    activenum++;
     if(learn_parm->sharedslack)
       lastiter=last_suboptimal_at[docs[i]->slackid];
     else
@@ -3271,7 +3314,7 @@ long shrink_problem(DOC **docs,
      && (shrink_state->deactnum<shrink_state->maxhistory)) { /* and enough memory */
     /* Shrink problem by removing those variables which are */
     /* optimal at a bound for a minimum number of iterations */
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf(" Shrinking..."); fflush(stdout);
     }
     if(kernel_parm->kernel_type != LINEAR) { /*  non-linear case save alphas */
@@ -3281,7 +3324,8 @@ long shrink_problem(DOC **docs,
 	a_old[i]=a[i];
       }
     }
-    for(ii=0;active2dnum[ii]>=0;ii++) {
+#pragma omp parallel for private(i,lastiter) schedule(static) if(activenum >= PARALLEL_MIN_DOCS)
+    for(ii=0;ii<activenum;ii++) {
       i=active2dnum[ii];
       if(learn_parm->sharedslack)
 	lastiter=last_suboptimal_at[docs[i]->slackid];
@@ -3298,7 +3342,7 @@ long shrink_problem(DOC **docs,
     if(kernel_parm->kernel_type == LINEAR) { 
       shrink_state->deactnum=0;
     }
-    if(verbosity>=2) {
+    if(svm_context()->verbosity>=2) {
       printf("done.\n"); fflush(stdout);
       printf(" Number of inactive variables = %ld\n",totdoc-activenum);
     }
@@ -3331,8 +3375,7 @@ void reactivate_inactive_examples(long int *label,
 {
   register long i,j,ii,jj,t,*changed2dnum,*inactive2dnum;
   long *changed,*inactive;
-  register double kernel_val,*a_old,dist;
-  double ex_c,target;
+  register double kernel_val,*a_old;
   SVECTOR *f;
 
   if(kernel_parm->kernel_type == LINEAR) { /* special linear case */
@@ -3346,6 +3389,7 @@ void reactivate_inactive_examples(long int *label,
 	a_old[i]=a[i];
       }
     }
+#pragma omp parallel for private(f) schedule(static) if(totdoc >= PARALLEL_MIN_DOCS)
     for(i=0;i<totdoc;i++) {
       if(!shrink_state->active[i]) {
 	for(f=docs[i]->fvec;f;f=f->next)  
@@ -3360,7 +3404,7 @@ void reactivate_inactive_examples(long int *label,
     inactive=(long *)my_malloc(sizeof(long)*totdoc);
     inactive2dnum=(long *)my_malloc(sizeof(long)*(totdoc+11));
     for(t=shrink_state->deactnum-1;(t>=0) && shrink_state->a_history[t];t--) {
-      if(verbosity>=2) {
+      if(svm_context()->verbosity>=2) {
 	printf("%ld..",t); fflush(stdout);
       }
       a_old=shrink_state->a_history[t];    
@@ -3387,6 +3431,10 @@ void reactivate_inactive_examples(long int *label,
     free(inactive2dnum);
   }
   (*maxdiff)=0;
+#pragma omp parallel if(totdoc >= PARALLEL_MIN_DOCS)
+  {
+  double dist,ex_c,target,thread_maxdiff=0;
+#pragma omp for schedule(static)
   for(i=0;i<totdoc;i++) {
     shrink_state->inactive_since[i]=shrink_state->deactnum-1;
     if(!inconsistent[i]) {
@@ -3394,12 +3442,12 @@ void reactivate_inactive_examples(long int *label,
       target=-(learn_parm->eps-(double)label[i]*c[i]);
       ex_c=learn_parm->svm_cost[i]-learn_parm->epsilon_a;
       if((a[i]>learn_parm->epsilon_a) && (dist > target)) {
-	if((dist-target)>(*maxdiff))  /* largest violation */
-	  (*maxdiff)=dist-target;
+	if((dist-target)>thread_maxdiff)  /* largest violation */
+	  thread_maxdiff=dist-target;
       }
       else if((a[i]<ex_c) && (dist < target)) {
-	if((target-dist)>(*maxdiff))  /* largest violation */
-	  (*maxdiff)=target-dist;
+	if((target-dist)>thread_maxdiff)  /* largest violation */
+	  thread_maxdiff=target-dist;
       }
       if((a[i]>(0+learn_parm->epsilon_a)) 
 	 && (a[i]<ex_c)) { 
@@ -3417,6 +3465,12 @@ void reactivate_inactive_examples(long int *label,
       }
     }
   }
+#pragma omp critical (svm_reactivate_inactive)
+  {
+  if(thread_maxdiff>(*maxdiff))
+    (*maxdiff)=thread_maxdiff;
+  }
+  }
   if(kernel_parm->kernel_type != LINEAR) { /* update history for non-linear */
     for(i=0;i<totdoc;i++) {
       (shrink_state->a_history[shrink_state->deactnum-1])[i]=a[i];
@@ -3517,7 +3571,7 @@ void kernel_cache_shrink(KERNEL_CACHE *kernel_cache, long int totdoc,
   register long i,j,jj,from=0,to=0,scount;  
   long *keep;
 
-  if(verbosity>=2) {
+  if(svm_context()->verbosity>=2) {
     printf(" Reorganizing cache..."); fflush(stdout);
   }
 
@@ -3567,7 +3621,7 @@ void kernel_cache_shrink(KERNEL_CACHE *kernel_cache, long int totdoc,
 
   free(keep);
 
-  if(verbosity>=2) {
+  if(svm_context()->verbosity>=2) {
     printf("done.\n"); fflush(stdout);
     printf(" Cache-size in rows = %ld\n",kernel_cache->max_elems);
   }
@@ -3594,9 +3648,9 @@ KERNEL_CACHE *kernel_cache_init(long int totdoc, long int buffsize)
     kernel_cache->max_elems=totdoc;
   }
 
-  if(verbosity>=2) {
+  if(svm_context()->verbosity>=2) {
     printf(" Cache-size in rows = %ld\n",kernel_cache->max_elems);
-    printf(" Kernel evals so far: %ld\n",kernel_cache_statistic);    
+    printf(" Kernel evals so far: %ld\n",svm_context()->kernel_cache_statistic);    
   }
 
   kernel_cache->elems=0;   /* initialize cache */
@@ -4092,7 +4146,7 @@ void write_prediction(char *predfile, MODEL *model, double *lin,
   long i;
   double dist,a_max;
 
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("Writing prediction file..."); fflush(stdout);
   }
   if ((predfl = fopen (predfile, "w")) == NULL)
@@ -4120,7 +4174,7 @@ void write_prediction(char *predfile, MODEL *model, double *lin,
     }
   }
   fclose(predfl);
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("done\n");
   }
 }
@@ -4131,7 +4185,7 @@ void write_alphas(char *alphafile, double *a,
   FILE *alphafl;
   long i;
 
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("Writing alpha file..."); fflush(stdout);
   }
   if ((alphafl = fopen (alphafile, "w")) == NULL)
@@ -4140,7 +4194,7 @@ void write_alphas(char *alphafile, double *a,
     fprintf(alphafl,"%.18g\n",a[i]*(double)label[i]);
   }
   fclose(alphafl);
-  if(verbosity>=1) {
+  if(svm_context()->verbosity>=1) {
     printf("done\n");
   }
 }
@@ -23,7 +23,7 @@
 
 void   svm_learn_classification(DOC **, double *, long, long, LEARN_PARM *, 
 				KERNEL_PARM *, KERNEL_CACHE *, MODEL *,
-				double *);
+				double *, SVM_CONTEXT *);
 void   svm_learn_regression(DOC **, double *, long, long, LEARN_PARM *, 
 			    KERNEL_PARM *, KERNEL_CACHE **, MODEL *);
 void   svm_learn_ranking(DOC **, double *, long, long, LEARN_PARM *, 